@@ -1,8 +1,11 @@
 #include "Moves.h"
-#include "TextureManager.h"
-#include "simulateMoves.h"
+#include "pieces.h"
+#include "evaluate.h"
+#include "trace.h"
+#include "zobrist.h"
 
-#include <array>
+#include <algorithm>
+#include <initializer_list>
 #include <optional>
 #include <vector>
 
@@ -18,319 +21,631 @@ int colorOf(int piece) {
   return (piece - 1) / 6;
 }
 
-static inline bool isEnemy(int piece, int other) {
-  if (other == EMPTY)
-    return false;
-  return colorOf(piece) != colorOf(other);
+// WHITE piece of the same kind, e.g. B_ROOK -> W_ROOK
+static inline int pieceType(int piece) {
+  return piece > W_KING ? piece - 6 : piece;
 }
 
-static inline bool isFriend(int piece, int other) {
-  if (other == EMPTY)
-    return false;
-  return colorOf(piece) == colorOf(other);
+// The four castling moves: the right they need, where king and rook start
+// and end, and the squares between them that must be empty.
+struct CastlingMove {
+  int right;
+  int kingFrom, kingTo;
+  int rookFrom, rookTo;
+  Bitboard between;
+};
+
+static constexpr CastlingMove CASTLING_MOVES[4] = {
+    {CASTLE_WHITE_KINGSIDE, 60, 62, 63, 61, squareBB(61) | squareBB(62)},
+    {CASTLE_WHITE_QUEENSIDE, 60, 58, 56, 59,
+     squareBB(57) | squareBB(58) | squareBB(59)},
+    {CASTLE_BLACK_KINGSIDE, 4, 6, 7, 5, squareBB(5) | squareBB(6)},
+    {CASTLE_BLACK_QUEENSIDE, 4, 2, 0, 3,
+     squareBB(1) | squareBB(2) | squareBB(3)},
+};
+
+static const CastlingMove &castlingFor(int kingTo) {
+  for (const CastlingMove &c : CASTLING_MOVES) {
+    if (c.kingTo == kingTo)
+      return c;
+  }
+  return CASTLING_MOVES[0]; // not reached for a MOVE_CASTLE
 }
 
-static void addSlidingMoves(std::vector<Move> &out, int piece, sf::Vector2i pos,
-                            int (&BOARD)[8][8],
-                            const std::vector<sf::Vector2i> &directions) {
-  for (auto d : directions) {
-    int x = pos.x + d.x;
-    int y = pos.y + d.y;
-
-    while (inBounds(x, y)) {
-      int cell = BOARD[y][x];
-
-      if (cell == EMPTY) {
-        out.push_back(Move{pos, {x, y}});
-      } else {
-        if (isEnemy(piece, cell))
-          out.push_back(Move{pos, {x, y}});
-        break; // blocked
-      }
-
-      x += d.x;
-      y += d.y;
+namespace {
+
+// keptRights[sq]: the castling rights that survive a move from or to sq.
+// Moving a king or rook, or capturing a rook, loses the rights it had.
+struct CastlingMasks {
+  int keptRights[64];
+  CastlingMasks() {
+    for (int &rights : keptRights)
+      rights = 15;
+    for (const CastlingMove &c : CASTLING_MOVES) {
+      keptRights[c.kingFrom] &= ~c.right;
+      keptRights[c.rookFrom] &= ~c.right;
     }
   }
-}
-
-std::vector<Move> removeIllegalMoves(int piece, std::vector<Move> moves,
-                                     GameState current) {
-  std::vector<Move> validMoves;
+} castlingMasks;
 
-  const int mover = current.sideToMove; // side making the move right now
+} // namespace
 
-  for (const Move &move : moves) {
-    GameState simulated = simulateMove(current, move);
+static void addMoves(MoveList &out, int from, Bitboard targets) {
+  while (targets)
+    out.push_back(Move(from, popLsb(targets)));
+}
 
-    if (!isInCheck(simulated, mover)) {
-      validMoves.push_back(move);
-    } else {
-      std::cout << "check detected!" << std::endl;
+// The first and last ranks, where a pawn move promotes.
+static constexpr Bitboard PROMOTION_RANKS = 0xFF000000000000FFULL;
+
+// Promotions of the pawn on `from` to `targets`, to one of four pieces. The
+// queen promotion is a tactical move even without a capture (see GenType).
+static void addPromotions(MoveList &out, const GameState &current, int from,
+                          Bitboard targets, GenType type) {
+  while (targets) {
+    const int to = popLsb(targets);
+    const bool capture = current.occupied & squareBB(to);
+    if (type != GEN_QUIETS)
+      out.push_back(Move(from, to, MOVE_PROMOTE_QUEEN));
+    if (capture ? type != GEN_QUIETS : type != GEN_CAPTURES) {
+      for (int flag : {MOVE_PROMOTE_KNIGHT, MOVE_PROMOTE_BISHOP,
+                       MOVE_PROMOTE_ROOK})
+        out.push_back(Move(from, to, flag));
     }
   }
-  return validMoves;
 }
 
-std::vector<Move> calculatePossibleMoves(int piece, sf::Vector2i position,
-                                         GameState current) {
-  std::vector<Move> moves;
+// Puts `piece` on an empty square, takes it off, or moves it, keeping the
+// bitboards, hash key and evaluation totals in step with board[]. The
+// caller updates `occupied`.
+static inline void putPiece(GameState &state, int piece, int sq) {
+  const int color = colorOf(piece);
+  state.board[sq] = piece;
+  state.pieces[piece] |= squareBB(sq);
+  state.occupancy[color] |= squareBB(sq);
+  state.key ^= zobristPieces[piece][sq];
+  state.material[color] += PIECE_VALUES[piece];
+  state.positional[color] += PST.value[piece][sq];
+}
 
-  if (piece == EMPTY)
-    return moves;
-  if (!inBounds(position.x, position.y))
-    return moves;
+static inline void removePiece(GameState &state, int piece, int sq) {
+  const int color = colorOf(piece);
+  state.board[sq] = EMPTY;
+  state.pieces[piece] ^= squareBB(sq);
+  state.occupancy[color] ^= squareBB(sq);
+  state.key ^= zobristPieces[piece][sq];
+  state.material[color] -= PIECE_VALUES[piece];
+  state.positional[color] -= PST.value[piece][sq];
+}
 
-  const int myColor = colorOf(piece);
-  const bool isWhite = (myColor == 0);
-  const bool isBlack = (myColor == 1);
+static inline void movePiece(GameState &state, int piece, int from, int to) {
+  const int color = colorOf(piece);
+  const Bitboard fromTo = squareBB(from) | squareBB(to);
+  state.board[from] = EMPTY;
+  state.board[to] = piece;
+  state.pieces[piece] ^= fromTo;
+  state.occupancy[color] ^= fromTo;
+  state.key ^= zobristPieces[piece][from] ^ zobristPieces[piece][to];
+  state.positional[color] += PST.value[piece][to] - PST.value[piece][from];
+}
 
-  // ---------------- Pawns ----------------
-  if (piece == W_PAWN || piece == B_PAWN) {
-    const int dir = isWhite ? -1 : +1;
-    const int startRank = isWhite ? 6 : 1;
+void refreshGameState(GameState &state) {
+  std::fill(std::begin(state.pieces), std::end(state.pieces), 0);
+  state.occupancy[WHITE] = state.occupancy[BLACK] = 0;
+
+  state.key = state.sideToMove == BLACK ? zobristBlackToMove : 0;
+  for (int sq = 0; sq < 64; ++sq) {
+    int piece = state.board[sq];
+    if (piece == EMPTY)
+      continue;
+    state.pieces[piece] |= squareBB(sq);
+    state.occupancy[colorOf(piece)] |= squareBB(sq);
+    state.key ^= zobristPieces[piece][sq];
+    if (piece == W_KING)
+      state.kingSquare[WHITE] = sq;
+    if (piece == B_KING)
+      state.kingSquare[BLACK] = sq;
+  }
+  state.occupied = state.occupancy[WHITE] | state.occupancy[BLACK];
+  state.key ^= zobristCastling[state.castling];
+  if (state.epSquare >= 0)
+    state.key ^= zobristEnPassant[fileOf(state.epSquare)];
 
-    const int x = position.x;
-    const int y = position.y;
+  computeEvalTotals(state, state.material, state.positional);
+}
 
-    // 1 step forward
-    int y1 = y + dir;
-    if (inBounds(x, y1) && current.board[y1][x] == EMPTY) {
-      moves.push_back(Move{{x, y}, {x, y1}});
+// Pieces of `color` attacking `sq`, with `occupied` standing in for the
+// board's occupancy so the king's own square can be looked through.
+static Bitboard attackersTo(const GameState &state, int sq, Bitboard occupied,
+                            int color) {
+  const int offset = (color == WHITE) ? 0 : 6; // W_xxx -> B_xxx
+  const Bitboard queens = state.pieces[W_QUEEN + offset];
+  return (pawnAttacks[color ^ 1][sq] & state.pieces[W_PAWN + offset]) |
+         (knightAttacks[sq] & state.pieces[W_KNIGHT + offset]) |
+         (kingAttacks[sq] & state.pieces[W_KING + offset]) |
+         (rookAttacks(sq, occupied) &
+          (state.pieces[W_ROOK + offset] | queens)) |
+         (bishopAttacks(sq, occupied) &
+          (state.pieces[W_BISHOP + offset] | queens));
+}
 
-      // 2 steps forward
-      int y2 = y + 2 * dir;
-      if (y == startRank && inBounds(x, y2) && current.board[y2][x] == EMPTY) {
-        moves.push_back(Move{{x, y}, {x, y2}});
-      }
-    }
+// What the generator needs to know about one side's king, worked out once
+// per position instead of playing every move and testing for check.
+struct KingSafety {
+  int kingSq;
+  Bitboard checkers; // enemy pieces giving check
+  Bitboard pinned;   // own pieces that may only move along the line to the king
+  // squares any non-king move must land on: everywhere when not in check,
+  // the checker or a square blocking it in single check, none in double check
+  Bitboard evasions;
+};
+
+static KingSafety kingSafety(const GameState &state, int color) {
+  KingSafety ks;
+  ks.kingSq = state.kingSquare[color];
+  ks.checkers = attackersTo(state, ks.kingSq, state.occupied, color ^ 1);
+
+  // an enemy slider lined up with the king pins the piece between them if
+  // that piece is the only one in the way and it is ours
+  const int offset = (color == WHITE) ? 6 : 0; // enemy pieces
+  const Bitboard queens = state.pieces[W_QUEEN + offset];
+  Bitboard snipers =
+      (rookAttacks(ks.kingSq, 0) & (state.pieces[W_ROOK + offset] | queens)) |
+      (bishopAttacks(ks.kingSq, 0) &
+       (state.pieces[W_BISHOP + offset] | queens));
+  ks.pinned = 0;
+  while (snipers) {
+    const Bitboard blockers =
+        betweenBB[ks.kingSq][popLsb(snipers)] & state.occupied;
+    if (popCount(blockers) == 1 && (blockers & state.occupancy[color]))
+      ks.pinned |= blockers;
+  }
 
-    for (int dx : {-1, +1}) {
-      int cx = x + dx;
-      int cy = y + dir;
-      if (inBounds(cx, cy) && isEnemy(piece, current.board[cy][cx])) {
-        moves.push_back(Move{{x, y}, {cx, cy}});
-      }
-    }
+  if (!ks.checkers) {
+    ks.evasions = ~0ULL;
+  } else {
+    TRACE(TRACE_IN_CHECK, ks.kingSq, popCount(ks.checkers));
+    ks.evasions = popCount(ks.checkers) == 1
+                      ? ks.checkers | betweenBB[ks.kingSq][lsb(ks.checkers)]
+                      : 0;
   }
+  return ks;
+}
 
-  // ---------------- Knights ----------------
-  if (piece == W_KNIGHT || piece == B_KNIGHT) {
-    static const std::array<sf::Vector2i, 8> jumps = {{{+1, +2},
-                                                       {+2, +1},
-                                                       {+2, -1},
-                                                       {+1, -2},
-                                                       {-1, -2},
-                                                       {-2, -1},
-                                                       {-2, +1},
-                                                       {-1, +2}}};
-
-    for (auto j : jumps) {
-      int nx = position.x + j.x;
-      int ny = position.y + j.y;
-      if (!inBounds(nx, ny))
-        continue;
-
-      int cell = current.board[ny][nx];
-      if (cell == EMPTY || isEnemy(piece, cell)) {
-        moves.push_back(Move{position, {nx, ny}});
-      }
+// Squares `myColor`'s piece on `from` can legally move to.
+static Bitboard legalTargets(const GameState &current, const KingSafety &ks,
+                             int piece, int myColor, int from) {
+  const Bitboard notOwn = ~current.occupancy[myColor];
+  Bitboard targets = 0;
+
+  switch (pieceType(piece)) {
+  case W_PAWN: {
+    const int dir = (myColor == WHITE) ? -8 : +8;
+    const int startRank = (myColor == WHITE) ? 6 : 1;
+
+    // 1 step forward, then 2 steps from the start rank
+    int to = from + dir;
+    if (to >= 0 && to < 64 && !(current.occupied & squareBB(to))) {
+      targets |= squareBB(to);
+      if (rowOf(from) == startRank && !(current.occupied & squareBB(to + dir)))
+        targets |= squareBB(to + dir);
     }
+    targets |= pawnAttacks[myColor][from] & current.occupancy[myColor ^ 1];
+    break;
   }
-
-  // ---------------- King ----------------
-  if (piece == W_KING || piece == B_KING) {
-    for (int dy = -1; dy <= 1; ++dy) {
-      for (int dx = -1; dx <= 1; ++dx) {
-        if (dx == 0 && dy == 0)
-          continue;
-        int nx = position.x + dx;
-        int ny = position.y + dy;
-        if (!inBounds(nx, ny))
-          continue;
-
-        int cell = current.board[ny][nx];
-        if (cell == EMPTY || isEnemy(piece, cell)) {
-          moves.push_back(Move{position, {nx, ny}});
-        }
-      }
+  case W_KNIGHT:
+    targets = knightAttacks[from] & notOwn;
+    break;
+  case W_KING: {
+    // the king may not step onto an attacked square. Its own square is
+    // taken off the board first so it can't back away along a checking ray.
+    const Bitboard occupied = current.occupied ^ squareBB(from);
+    Bitboard candidates = kingAttacks[from] & notOwn;
+    while (candidates) {
+      int to = popLsb(candidates);
+      if (!attackersTo(current, to, occupied, myColor ^ 1))
+        targets |= squareBB(to);
     }
+    break;
+  }
+  case W_ROOK:
+    targets = rookAttacks(from, current.occupied) & notOwn;
+    break;
+  case W_BISHOP:
+    targets = bishopAttacks(from, current.occupied) & notOwn;
+    break;
+  case W_QUEEN:
+    targets = queenAttacks(from, current.occupied) & notOwn;
+    break;
   }
 
-  static const std::vector<sf::Vector2i> rookDirs = {
-      {+1, 0}, {-1, 0}, {0, +1}, {0, -1}};
-  static const std::vector<sf::Vector2i> bishopDirs = {
-      {+1, +1}, {+1, -1}, {-1, +1}, {-1, -1}};
+  if (pieceType(piece) != W_KING) {
+    targets &= ks.evasions;
+    if (ks.pinned & squareBB(from))
+      targets &= lineBB[ks.kingSq][from];
+  }
+  return targets;
+}
 
-  if (piece == W_ROOK || piece == B_ROOK) {
-    addSlidingMoves(moves, piece, position, current.board, rookDirs);
+static Bitboard genTypeMask(const GameState &current, int myColor,
+                            GenType type) {
+  switch (type) {
+  case GEN_CAPTURES:
+    return current.occupancy[myColor ^ 1];
+  case GEN_QUIETS:
+    return ~current.occupied;
+  default:
+    return ~0ULL;
   }
+}
 
-  if (piece == W_BISHOP || piece == B_BISHOP) {
-    addSlidingMoves(moves, piece, position, current.board, bishopDirs);
+// Whether the pawn on `from` may take en passant. Both pawns leave the
+// capturing pawn's rank, which can uncover a slider along it, so instead of
+// the pin and check masks the king is tested directly on the board as it
+// would be after the capture.
+static bool legalEnPassant(const GameState &current, const KingSafety &ks,
+                           int myColor, int from) {
+  const int ep = current.epSquare;
+  const int capturedSq = squareOf(fileOf(ep), rowOf(from));
+  const Bitboard occupied =
+      (current.occupied ^ squareBB(from) ^ squareBB(capturedSq)) |
+      squareBB(ep);
+  return !(attackersTo(current, ks.kingSq, occupied, myColor ^ 1) & occupied);
+}
+
+// Castling for the king on its home square: the right is still there, the
+// squares up to the rook are empty, and the king is not in check and does
+// not pass through or land on an attacked square.
+static void addCastling(MoveList &out, const GameState &current,
+                        const KingSafety &ks, int myColor) {
+  if (ks.checkers)
+    return;
+  const int ownRights = myColor == WHITE
+                            ? CASTLE_WHITE_KINGSIDE | CASTLE_WHITE_QUEENSIDE
+                            : CASTLE_BLACK_KINGSIDE | CASTLE_BLACK_QUEENSIDE;
+  for (const CastlingMove &c : CASTLING_MOVES) {
+    if (!(current.castling & ownRights & c.right) ||
+        (current.occupied & c.between))
+      continue;
+    const int passed = (c.kingFrom + c.kingTo) / 2;
+    if (attackersTo(current, passed, current.occupied, myColor ^ 1) ||
+        attackersTo(current, c.kingTo, current.occupied, myColor ^ 1))
+      continue;
+    out.push_back(Move(c.kingFrom, c.kingTo, MOVE_CASTLE));
   }
+}
 
-  if (piece == W_QUEEN || piece == B_QUEEN) {
-    std::vector<sf::Vector2i> queenDirs = rookDirs;
-    queenDirs.insert(queenDirs.end(), bishopDirs.begin(), bishopDirs.end());
-    addSlidingMoves(moves, piece, position, current.board, queenDirs);
+// En passant captures by those of `myColor`'s `pawns` that are next to the
+// pawn that just made a double step.
+static void addEnPassant(MoveList &out, const GameState &current,
+                         const KingSafety &ks, int myColor, Bitboard pawns) {
+  if (current.epSquare < 0 || myColor != current.sideToMove)
+    return;
+  Bitboard attackers = pawns & pawnAttacks[myColor ^ 1][current.epSquare];
+  while (attackers) {
+    const int from = popLsb(attackers);
+    if (legalEnPassant(current, ks, myColor, from))
+      out.push_back(Move(from, current.epSquare, MOVE_EN_PASSANT));
   }
+}
 
-  std::vector<Move> validMoves = removeIllegalMoves(piece, moves, current);
-  return validMoves;
+// Appends the moves of `myColor`'s piece on `from` to the squares in `mask`
+// (see genTypeMask), except castling and en passant.
+static void addPieceMoves(MoveList &out, const GameState &current,
+                          const KingSafety &ks, int piece, int myColor,
+                          int from, Bitboard mask, GenType type) {
+  const Bitboard targets = legalTargets(current, ks, piece, myColor, from);
+  if (pieceType(piece) == W_PAWN && (targets & PROMOTION_RANKS)) {
+    addMoves(out, from, targets & ~PROMOTION_RANKS & mask);
+    addPromotions(out, current, from, targets & PROMOTION_RANKS, type);
+  } else {
+    addMoves(out, from, targets & mask);
+  }
 }
 
-bool isSquareAttacked(int (&BOARD)[8][8], sf::Vector2i target,
-                      int attackerColor) {
-  const int tx = target.x;
-  const int ty = target.y;
-  if (!inBounds(tx, ty))
-    return false;
-  // pawns!!
-  if (attackerColor == WHITE) {
-    int py = ty + 1;
-    if (inBounds(tx - 1, py) && BOARD[py][tx - 1] == W_PAWN) {
-      std::cout << "Attacked by pawn" << std::endl;
-      return true;
-    }
-    if (inBounds(tx + 1, py) && BOARD[py][tx + 1] == W_PAWN) {
-      std::cout << "Attacked by pawn" << std::endl;
-      return true;
-    }
-  } else if (attackerColor == BLACK) {
-    int py = ty - 1;
-    if (inBounds(tx - 1, py) && BOARD[py][tx - 1] == B_PAWN) {
-      std::cout << "Attacked by pawn" << std::endl;
-      return true;
-    }
-    if (inBounds(tx + 1, py) && BOARD[py][tx + 1] == B_PAWN) {
-      std::cout << "Attacked by pawn" << std::endl;
-      return true;
-    }
+void generatePieceMoves(int piece, Coord position,
+                        const GameState &current, MoveList &moves) {
+  if (piece == EMPTY)
+    return;
+  if (!inBounds(position.x, position.y))
+    return;
+  const int color = colorOf(piece);
+  const int from = squareOf(position.x, position.y);
+  const KingSafety ks = kingSafety(current, color);
+  addPieceMoves(moves, current, ks, piece, color, from, ~0ULL, GEN_ALL);
+  if (pieceType(piece) == W_PAWN)
+    addEnPassant(moves, current, ks, color, squareBB(from));
+  if (pieceType(piece) == W_KING)
+    addCastling(moves, current, ks, color);
+}
+
+void generateMoves(const GameState &current, MoveList &moves, GenType type) {
+  const int side = current.sideToMove;
+  const Bitboard mask = genTypeMask(current, side, type);
+  const KingSafety ks = kingSafety(current, side);
+
+  // squares in board order (a8, b8, ... h1), the order the search has always
+  // seen the moves in. In double check only the king can move.
+  Bitboard own = current.occupancy[side];
+  if (!ks.evasions)
+    own = squareBB(ks.kingSq);
+  while (own) {
+    int sq = popLsb(own);
+    addPieceMoves(moves, current, ks, current.board[sq],
+                  side, sq, mask, type);
   }
 
-  // knights!!
-  static const std::array<sf::Vector2i, 8> knightD = {{{+1, +2},
-                                                       {+2, +1},
-                                                       {+2, -1},
-                                                       {+1, -2},
-                                                       {-1, -2},
-                                                       {-2, -1},
-                                                       {-2, +1},
-                                                       {-1, +2}}};
-  const int attackerKnight =
-      (attackerColor == WHITE)
-          ? W_KNIGHT
-          : B_KNIGHT; // pick out which knight we care about
-  for (auto d : knightD) {
-    if (inBounds(tx + d.x, ty + d.y) &&
-        BOARD[ty + d.y][tx + d.x] == attackerKnight) {
-      std::cout << "Attacked by Knight" << std::endl;
-      return true;
-    }
+  // the special moves come last
+  if (type != GEN_QUIETS)
+    addEnPassant(moves, current, ks, side,
+                 current.pieces[side == WHITE ? W_PAWN : B_PAWN]);
+  if (type != GEN_CAPTURES)
+    addCastling(moves, current, ks, side);
+}
+
+void generateAllMoves(const GameState &current, MoveList &moves) {
+  moves.clear();
+  generateMoves(current, moves, GEN_ALL);
+}
+
+bool isTactical(const GameState &current, const Move &move) {
+  return move.flag() == MOVE_EN_PASSANT ||
+         move.flag() == MOVE_PROMOTE_QUEEN ||
+         current.board[move.to()] != EMPTY;
+}
+
+int capturedPiece(const GameState &current, const Move &move) {
+  if (move.flag() == MOVE_EN_PASSANT)
+    return current.sideToMove == WHITE ? B_PAWN : W_PAWN;
+  return current.board[move.to()];
+}
+
+bool isLegalMove(const GameState &current, const Move &move) {
+  if (move == MOVE_NONE)
+    return false;
+  const int from = move.from();
+  const int to = move.to();
+  const int piece = current.board[from];
+  const int side = current.sideToMove;
+  if (piece == EMPTY || colorOf(piece) != side)
+    return false;
+  const KingSafety ks = kingSafety(current, side);
+
+  switch (move.flag()) {
+  case MOVE_NORMAL:
+  case MOVE_PROMOTE_KNIGHT:
+  case MOVE_PROMOTE_BISHOP:
+  case MOVE_PROMOTE_ROOK:
+  case MOVE_PROMOTE_QUEEN:
+    break;
+  case MOVE_CASTLE:
+  case MOVE_EN_PASSANT: {
+    // these have conditions of their own: generate them
+    MoveList moves;
+    if (move.flag() == MOVE_CASTLE && pieceType(piece) == W_KING)
+      addCastling(moves, current, ks, side);
+    if (move.flag() == MOVE_EN_PASSANT && pieceType(piece) == W_PAWN)
+      addEnPassant(moves, current, ks, side, squareBB(from));
+    return std::find(moves.begin(), moves.end(), move) != moves.end();
+  }
+  default:
+    return false; // no move has this flag
   }
+  if (!(legalTargets(current, ks, piece, side, from) & squareBB(to)))
+    return false;
+  // a pawn reaching the last rank has to promote, and nothing else may
+  const bool promotes =
+      pieceType(piece) == W_PAWN && (rowOf(to) == 0 || rowOf(to) == 7);
+  return promotes == move.isPromotion();
+}
+
+std::vector<Move> calculatePossibleMoves(int piece, Coord position,
+                                         const GameState &current) {
+  MoveList moves;
+  generatePieceMoves(piece, position, current, moves);
+  return std::vector<Move>(moves.begin(), moves.end());
+}
 
-  const int attackerKing = (attackerColor == WHITE) ? W_KING : B_KING;
-  for (int dy = -1; dy <= 1; ++dy) {
-    for (int dx = -1; dx <= 1; ++dx) {
-      if (dx == 0 && dy == 0)
-        continue;
-      int x = tx + dx, y = ty + dy;
-      if (inBounds(x, y) && BOARD[y][x] == attackerKing) {
-        std::cout << "Attacked by King" << std::endl;
-        return true;
+int staticExchange(const GameState &current, const Move &move) {
+  const int to = move.to();
+  const Bitboard queens = current.pieces[W_QUEEN] | current.pieces[B_QUEEN];
+  const Bitboard diagonal =
+      current.pieces[W_BISHOP] | current.pieces[B_BISHOP] | queens;
+  const Bitboard straight =
+      current.pieces[W_ROOK] | current.pieces[B_ROOK] | queens;
+
+  // gain[d] is what the side making capture d has won so far if the
+  // exchange stops there
+  int gain[32];
+  int d = 0;
+  gain[0] = PIECE_VALUES[capturedPiece(current, move)];
+
+  Bitboard occupied = current.occupied;
+  if (move.flag() == MOVE_EN_PASSANT)
+    occupied ^= squareBB(squareOf(fileOf(to), rowOf(move.from())));
+  Bitboard attackers = (attackersTo(current, to, occupied, WHITE) |
+                        attackersTo(current, to, occupied, BLACK)) &
+                       occupied;
+  Bitboard fromBB = squareBB(move.from());
+  int attacker = current.board[move.from()];
+  int side = colorOf(attacker);
+
+  while (fromBB && d < 31) {
+    ++d;
+    gain[d] = PIECE_VALUES[attacker] - gain[d - 1];
+    if (std::max(-gain[d - 1], gain[d]) < 0)
+      break; // neither side can come out ahead by going on
+
+    // the capturing piece leaves its square, uncovering any slider behind it
+    occupied ^= fromBB;
+    attackers |= (rookAttacks(to, occupied) & straight) |
+                 (bishopAttacks(to, occupied) & diagonal);
+    attackers &= occupied;
+
+    // the other side recaptures with its least valuable piece
+    side ^= 1;
+    fromBB = 0;
+    const int offset = (side == WHITE) ? 0 : 6;
+    for (int type : {W_PAWN, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING}) {
+      const Bitboard candidates = attackers & current.pieces[type + offset];
+      if (candidates) {
+        fromBB = candidates & -candidates;
+        attacker = type + offset;
+        break;
       }
     }
   }
 
-  static const std::array<sf::Vector2i, 4> rookDirs = {
-      {{+1, 0}, {-1, 0}, {0, +1}, {0, -1}}};
-  static const std::array<sf::Vector2i, 4> bishopDirs = {
-      {{+1, +1}, {+1, -1}, {-1, +1}, {-1, -1}}};
-
-  const int attackerRook = (attackerColor == WHITE) ? W_ROOK : B_ROOK;
-  const int attackerBish = (attackerColor == WHITE) ? W_BISHOP : B_BISHOP;
-  const int attackerQueen = (attackerColor == WHITE) ? W_QUEEN : B_QUEEN;
-
-  for (auto d : rookDirs) {
-    int x = tx + d.x, y = ty + d.y;
-    while (inBounds(x, y)) {
-      int p = BOARD[y][x];
-      if (p != EMPTY) {
-        if (p == attackerRook || p == attackerQueen) {
-          std::cout << "attacked by queen or rook" << std::endl;
-          return true;
-        }
-        break; // blocked by something else
-      }
-      x += d.x;
-      y += d.y;
-    }
+  // each side may stop recapturing whenever that is better for it
+  while (--d > 0)
+    gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+  return gain[0];
+}
+
+bool isSquareAttacked(const GameState &state, int sq, int attackerColor) {
+  const int offset = (attackerColor == WHITE) ? 0 : 6; // W_xxx -> B_xxx
+
+  // pawns!! a white pawn attacks sq from where a black pawn on sq would
+  // attack, and vice versa
+  if (pawnAttacks[attackerColor ^ 1][sq] & state.pieces[W_PAWN + offset]) {
+    TRACE(TRACE_ATTACKED_BY_PAWN, sq, attackerColor);
+    return true;
   }
 
-  for (auto d : bishopDirs) {
-    int x = tx + d.x, y = ty + d.y;
-    while (inBounds(x, y)) {
-      int p = BOARD[y][x];
-      if (p != EMPTY) {
-        if (p == attackerBish || p == attackerQueen) {
-          std::cout << "attacked by queen or bishop" << std::endl;
-          return true;
-        }
-        break;
-      }
-      x += d.x;
-      y += d.y;
-    }
+  // knights!!
+  if (knightAttacks[sq] & state.pieces[W_KNIGHT + offset]) {
+    TRACE(TRACE_ATTACKED_BY_KNIGHT, sq, attackerColor);
+    return true;
+  }
+
+  if (kingAttacks[sq] & state.pieces[W_KING + offset]) {
+    TRACE(TRACE_ATTACKED_BY_KING, sq, attackerColor);
+    return true;
+  }
+
+  const Bitboard queens = state.pieces[W_QUEEN + offset];
+  if (rookAttacks(sq, state.occupied) &
+      (state.pieces[W_ROOK + offset] | queens)) {
+    TRACE(TRACE_ATTACKED_BY_ROOK, sq, attackerColor);
+    return true;
+  }
+  if (bishopAttacks(sq, state.occupied) &
+      (state.pieces[W_BISHOP + offset] | queens)) {
+    TRACE(TRACE_ATTACKED_BY_BISHOP, sq, attackerColor);
+    return true;
   }
 
   return false;
 }
 
-bool isInCheck(GameState state, int color) {
+bool isInCheck(const GameState &state, int color) {
   int enemyColor = color ^ 1;
-  return isSquareAttacked(state.board, state.kingPos[color], enemyColor);
+  return isSquareAttacked(state, state.kingSquare[color], enemyColor);
 }
 
-GameState makeMove(const GameState &current, const Move &move,
-                   const std::optional<std::vector<Move>> &moves) {
-  sf::Vector2i SELECTED = move.from;
-  sf::Vector2i coordinate = move.to;
+void doMove(GameState &state, const Move &move, Undo &undo) {
+  const int from = move.from();
+  const int to = move.to();
+  const int piece = state.board[from];
+  const int color = colorOf(piece);
+  const int captured = capturedPiece(state, move);
+
+  undo.move = move;
+  undo.movedPiece = piece;
+  undo.capturedPiece = captured;
+  undo.castlingBefore = state.castling;
+  undo.epSquareBefore = state.epSquare;
+  undo.keyBefore = state.key;
+
+  if (move.flag() == MOVE_EN_PASSANT)
+    removePiece(state, captured, squareOf(fileOf(to), rowOf(from)));
+  else if (captured != EMPTY)
+    removePiece(state, captured, to);
+  movePiece(state, piece, from, to);
+
+  if (move.isPromotion()) {
+    removePiece(state, piece, to);
+    putPiece(state, promotionPiece(move, color), to);
+  } else if (move.flag() == MOVE_CASTLE) {
+    const CastlingMove &c = castlingFor(to);
+    movePiece(state, color == WHITE ? W_ROOK : B_ROOK, c.rookFrom, c.rookTo);
+  }
+  if (piece == W_KING || piece == B_KING)
+    state.kingSquare[color] = to;
+
+  // castling rights and the en passant square are hashed as well: XOR the
+  // old ones out and the new ones in
+  const int castling =
+      state.castling & castlingMasks.keptRights[from] &
+      castlingMasks.keptRights[to];
+  if (castling != state.castling) {
+    state.key ^= zobristCastling[state.castling] ^ zobristCastling[castling];
+    state.castling = castling;
+  }
+
+  if (state.epSquare >= 0)
+    state.key ^= zobristEnPassant[fileOf(state.epSquare)];
+  state.epSquare = -1;
+  if (pieceType(piece) == W_PAWN && (to - from == 16 || from - to == 16)) {
+    // only worth recording if an enemy pawn could take en passant
+    const int skipped = (from + to) / 2;
+    const int enemyPawn = color == WHITE ? B_PAWN : W_PAWN;
+    if (pawnAttacks[color][skipped] & state.pieces[enemyPawn]) {
+      state.epSquare = skipped;
+      state.key ^= zobristEnPassant[fileOf(skipped)];
+    }
+  }
+
+  state.occupied = state.occupancy[WHITE] | state.occupancy[BLACK];
+  state.key ^= zobristBlackToMove;
+  state.sideToMove ^= 1;
+}
 
-  auto pred = [&](const Move &m) {
-    return m.from == SELECTED && m.to == coordinate;
-  };
+void undoMove(GameState &state, const Undo &undo) {
+  const Move move = undo.move;
+  const int from = move.from();
+  const int to = move.to();
+  const int piece = undo.movedPiece;
+  const int color = colorOf(piece);
+  const int captured = undo.capturedPiece;
+
+  if (move.isPromotion()) {
+    removePiece(state, promotionPiece(move, color), to);
+    putPiece(state, piece, to);
+  } else if (move.flag() == MOVE_CASTLE) {
+    const CastlingMove &c = castlingFor(to);
+    movePiece(state, color == WHITE ? W_ROOK : B_ROOK, c.rookTo, c.rookFrom);
+  }
+  movePiece(state, piece, to, from);
+
+  if (move.flag() == MOVE_EN_PASSANT)
+    putPiece(state, captured, squareOf(fileOf(to), rowOf(from)));
+  else if (captured != EMPTY)
+    putPiece(state, captured, to);
+  if (piece == W_KING || piece == B_KING)
+    state.kingSquare[color] = from;
+
+  state.occupied = state.occupancy[WHITE] | state.occupancy[BLACK];
+  state.castling = undo.castlingBefore;
+  state.epSquare = undo.epSquareBefore;
+  state.key = undo.keyBefore;
+  state.sideToMove ^= 1;
+}
 
+GameState makeMove(const GameState &current, const Move &move,
+                   const std::optional<std::vector<Move>> &moves) {
   bool ok = true;
   if (moves) {
-    ok = (std::find_if(moves->begin(), moves->end(), pred) != moves->end());
+    ok = (std::find(moves->begin(), moves->end(), move) != moves->end());
   }
+  // nothing to move from an empty square
+  if (ok && current.board[move.from()] == EMPTY)
+    ok = false;
 
-  int BOARD[8][8];
-  std::copy(&current.board[0][0], &current.board[0][0] + 64, &BOARD[0][0]);
-
-  sf::Vector2i whiteKingPos = current.kingPos[0];
-  sf::Vector2i blackKingPos = current.kingPos[1];
-  int turn = current.sideToMove;
-
+  GameState newState = current;
   if (ok) {
-    int piece = BOARD[SELECTED.y][SELECTED.x];
-
-    if (piece == B_KING)
-      blackKingPos = {coordinate.x, coordinate.y};
-    if (piece == W_KING)
-      whiteKingPos = {coordinate.x, coordinate.y};
-
-    BOARD[SELECTED.y][SELECTED.x] = EMPTY;
-    BOARD[coordinate.y][coordinate.x] = piece;
-    turn ^= 1;
+    Undo undo;
+    doMove(newState, move, undo);
   }
-
-  GameState newState;
-  std::copy(&BOARD[0][0], &BOARD[0][0] + 64, &newState.board[0][0]);
-  newState.sideToMove = turn;
-  newState.kingPos[WHITE] = whiteKingPos;
-  newState.kingPos[BLACK] = blackKingPos;
-
   return newState;
 }
@@ -1,31 +1,184 @@
 #pragma once
-#include <SFML/System/Vector2.hpp>
+#include "bitboards.h"
+#include "pieces.h"
+#include <cstdint>
+#include <optional>
 #include <vector>
 
+// A square as (x, y) = (file, row of GameState::board), so y = 0 is Black's
+// back rank. The GUI's sf::Vector2i converts to it member by member.
+struct Coord {
+  int x = 0;
+  int y = 0;
+
+  bool operator==(const Coord &other) const {
+    return x == other.x && y == other.y;
+  }
+  bool operator!=(const Coord &other) const { return !(*this == other); }
+};
+
+// What kind of move a Move is, beyond a piece going from one square to
+// another.
+enum MoveFlag {
+  MOVE_NORMAL = 0,
+  MOVE_CASTLE = 1,     // the king's two-square move; the rook jumps over it
+  MOVE_EN_PASSANT = 2, // `to` is the empty square behind the captured pawn
+  // a pawn reaching the last rank, and what it becomes
+  MOVE_PROMOTE_KNIGHT = 4,
+  MOVE_PROMOTE_BISHOP = 5,
+  MOVE_PROMOTE_ROOK = 6,
+  MOVE_PROMOTE_QUEEN = 7
+};
+
+// A move packed into 16 bits: from square (bits 0-5), to square (6-11) and
+// MoveFlag (12-15), squares numbered as in bitboards.h. Castling is the
+// king's move (e1g1). Trivially copyable, so move lists and the hash table
+// hold 2 bytes per move; a default-constructed Move is uninitialised.
 struct Move {
-  sf::Vector2i from;
-  sf::Vector2i to;
+  uint16_t data;
+
+  Move() = default;
+  constexpr Move(int from, int to, int flag = MOVE_NORMAL)
+      : data(uint16_t(from | to << 6 | flag << 12)) {}
+
+  int from() const { return data & 63; }
+  int to() const { return (data >> 6) & 63; }
+  int flag() const { return data >> 12; }
+  bool isPromotion() const { return flag() >= MOVE_PROMOTE_KNIGHT; }
+
+  bool operator==(const Move &other) const { return data == other.data; }
+  bool operator!=(const Move &other) const { return data != other.data; }
+};
+
+// "No move" (a8 to a8, which is never legal): an empty hash move, the
+// result of a search with no legal moves, and so on.
+constexpr Move MOVE_NONE = Move(0, 0);
+
+// Piece a promotion turns the pawn into, for `color` (0 white, 1 black).
+inline int promotionPiece(const Move &move, int color) {
+  static const int PIECES[4] = {W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN};
+  return PIECES[move.flag() - MOVE_PROMOTE_KNIGHT] + color * 6;
+}
+
+// Fixed-capacity move list that lives on the stack, so generating moves never
+// touches the heap. No legal position has more than 218 moves. The slots are
+// left uninitialised until a move is written into them.
+struct MoveList {
+  static const int CAPACITY = 256;
+
+  Move moves[CAPACITY];
+  int count = 0;
+
+  void push_back(const Move &move) { moves[count++] = move; }
+  void clear() { count = 0; }
+  int size() const { return count; }
+  bool empty() const { return count == 0; }
+  Move &operator[](int i) { return moves[i]; }
+  const Move &operator[](int i) const { return moves[i]; }
+  Move *begin() { return moves; }
+  Move *end() { return moves + count; }
+  const Move *begin() const { return moves; }
+  const Move *end() const { return moves + count; }
 };
 
 struct Undo {
   Move move;
-  int movedPiece;
-  int capturedPiece;
-  sf::Vector2i kingPosBefore[2];
+  int movedPiece;    // the pawn, for a promotion
+  int capturedPiece; // also for en passant, where it is not on `to`
+  int castlingBefore;
+  int epSquareBefore;
+  uint64_t keyBefore;
+};
+
+// Castling rights, as bits of GameState::castling.
+enum CastlingRights {
+  CASTLE_WHITE_KINGSIDE = 1,
+  CASTLE_WHITE_QUEENSIDE = 2,
+  CASTLE_BLACK_KINGSIDE = 4,
+  CASTLE_BLACK_QUEENSIDE = 8
 };
 
+// One position, 224 bytes: the search threads and the GUI copy it around,
+// so it is kept small. Widest members first, to leave no padding.
 struct GameState {
-  int board[8][8];
-  int sideToMove;
-  sf::Vector2i kingPos[2];
+  // Bitboard view of `board`, kept in sync by makeMove. The search and move
+  // generator work from these; visiting every piece of a side is a walk
+  // over occupancy[side], not a scan of the 64 squares.
+  Bitboard pieces[13];   // one per PieceIDs value (pieces[EMPTY] is unused)
+  Bitboard occupancy[2]; // every piece of each colour
+  Bitboard occupied;     // occupancy[0] | occupancy[1]
+
+  // Zobrist hash of pieces, side to move, castling rights and en passant
+  // file (see zobrist.h)
+  uint64_t key;
+
+  // Evaluation totals per colour (see evaluate.h), kept in sync by doMove
+  int material[2];
+  int positional[2];
+
+  // PieceIDs by square (see bitboards.h), for "what is on this square"
+  int8_t board[64];
+  int8_t sideToMove;
+  int8_t kingSquare[2];
+
+  // Castling still allowed (CastlingRights bits): the king and that rook
+  // have not moved, and the rook has not been captured.
+  int8_t castling;
+  // Square a pawn just skipped with a double step, when an enemy pawn is
+  // placed to take it en passant; -1 otherwise.
+  int8_t epSquare;
 };
 
-std::vector<Move> calculatePossibleMoves(int piece, sf::Vector2i position,
-                                         GameState game);
-bool isInCheck(GameState current, int color);
+// Rebuilds everything derived from board[], sideToMove, castling and
+// epSquare (bitboards, king squares, hash key, evaluation totals). Call after
+// filling in a board by hand.
+void refreshGameState(GameState &state);
+
+// Legal moves for the piece on `position`. Checks and pins are worked out up
+// front, so only legal moves are generated and none has to be tried.
+std::vector<Move> calculatePossibleMoves(int piece, Coord position,
+                                         const GameState &game);
+// Same, appending to `moves` instead of returning a new vector.
+void generatePieceMoves(int piece, Coord position,
+                        const GameState &game, MoveList &moves);
+// Every legal move for the side to move, replacing what `moves` held. This is
+// what the search and perft use; it does no heap allocation.
+void generateAllMoves(const GameState &game, MoveList &moves);
+
+// Which legal moves generateMoves appends. GEN_CAPTURES is the tactical
+// moves: captures (en passant and capturing promotions included) and queen
+// promotions. GEN_QUIETS is everything else, castling and the other
+// promotions included. Lets the search skip the quiet moves when a capture
+// cuts off.
+enum GenType { GEN_CAPTURES, GEN_QUIETS, GEN_ALL };
+void generateMoves(const GameState &game, MoveList &moves, GenType type);
+
+// Whether `move` is one GEN_CAPTURES produces, and the piece it takes (EMPTY
+// if none).
+bool isTactical(const GameState &game, const Move &move);
+int capturedPiece(const GameState &game, const Move &move);
+
+// Whether `move` is legal for the side to move. For moves that did not come
+// from the generator, such as a hash move or a killer from another position.
+bool isLegalMove(const GameState &game, const Move &move);
+
+// Static exchange evaluation: the material the mover gains (or loses, if
+// negative) by the capture `move` once both sides have recaptured on that
+// square for as long as it pays them, least valuable piece first. Pins are
+// ignored.
+int staticExchange(const GameState &game, const Move &move);
+bool isSquareAttacked(const GameState &state, int sq, int attackerColor);
+bool isInCheck(const GameState &current, int color);
 
 int colorOf(int piece);
 
+// Plays `move` on `state` in place, recording what undoMove needs to take it
+// back. No legality check: the move must come from calculatePossibleMoves.
+void doMove(GameState &state, const Move &move, Undo &undo);
+void undoMove(GameState &state, const Undo &undo);
+
+// Copying version of doMove. When `moves` is given, the move is only played if
+// it is one of them; otherwise the state comes back unchanged.
 GameState
 makeMove(const GameState &current, const Move &move,
          const std::optional<std::vector<Move>> &moves = std::nullopt);
@@ -1,60 +1,46 @@
 #pragma once
+#include "pieces.h"
+#include "sprites.h"
 #include <SFML/Graphics.hpp>
 #include <iostream>
-#include <map>
 #include <string>
 
-enum PieceIDs {
-  EMPTY = 0,
-  W_PAWN = 1,
-  W_ROOK = 2,
-  W_KNIGHT = 3,
-  W_BISHOP = 4,
-  W_QUEEN = 5,
-  W_KING = 6,
-  B_PAWN = 7,
-  B_ROOK = 8,
-  B_KNIGHT = 9,
-  B_BISHOP = 10,
-  B_QUEEN = 11,
-  B_KING = 12
-};
-
+// Packs the piece sprites, which are compiled into the program (sprites.h),
+// into one texture atlas: white pieces on the top row and black on the
+// bottom, in PieceIDs order. The atlas is uploaded to the GPU once, and
+// every piece is drawn from it through a flat table indexed by PieceIDs.
 class TextureManager {
 private:
-  std::map<int, sf::Texture> textures;
+  static const unsigned CELL = 128; // sprite size in pixels
+
+  sf::Texture atlas;
+  sf::Vector2f cellPosition[13]; // top left of each piece's cell
 
 public:
   TextureManager() {
-    loadTexture(W_PAWN, "sprites/white-pawn.png");
-    loadTexture(W_ROOK, "sprites/white-rook.png");
-    loadTexture(W_KNIGHT, "sprites/white-knight.png");
-    loadTexture(W_BISHOP, "sprites/white-bishop.png");
-    loadTexture(W_QUEEN, "sprites/white-queen.png");
-    loadTexture(W_KING, "sprites/white-king.png");
-
-    loadTexture(B_PAWN, "sprites/black-pawn.png");
-    loadTexture(B_ROOK, "sprites/black-rook.png");
-    loadTexture(B_KNIGHT, "sprites/black-knight.png");
-    loadTexture(B_BISHOP, "sprites/black-bishop.png");
-    loadTexture(B_QUEEN, "sprites/black-queen.png");
-    loadTexture(B_KING, "sprites/black-king.png");
-  }
+    sf::Image atlasImage({CELL * 6, CELL * 2}, sf::Color::Transparent);
+    for (int id = W_PAWN; id <= B_KING; ++id) {
+      const unsigned column = (id - 1) % 6;
+      const unsigned row = (id - 1) / 6;
+      cellPosition[id] = {float(column * CELL), float(row * CELL)};
 
-  void loadTexture(int id, const std::string &filename) {
-    sf::Texture tex;
-    if (!tex.loadFromFile(filename)) {
-      std::cerr << "ERROR: Failed to load " << filename << std::endl;
-    } else {
-      tex.setSmooth(true);
-      textures[id] = tex;
+      const EmbeddedFile &sprite = PIECE_SPRITES[id - 1];
+      sf::Image image;
+      if (!image.loadFromMemory(sprite.data, sprite.size) ||
+          !atlasImage.copy(image, {column * CELL, row * CELL})) {
+        std::cerr << "ERROR: Failed to load the sprite for piece " << id
+                  << std::endl;
+      }
     }
-  }
 
-  sf::Texture *getTexture(int id) {
-    if (textures.find(id) != textures.end()) {
-      return &textures[id];
-    }
-    return nullptr;
+    if (!atlas.loadFromImage(atlasImage))
+      std::cerr << "ERROR: Failed to create the piece atlas" << std::endl;
+    atlas.setSmooth(true);
   }
+
+  const sf::Texture &getAtlas() const { return atlas; }
+
+  // Top left corner and size of a piece's cell in the atlas, in pixels.
+  sf::Vector2f getCellPosition(int id) const { return cellPosition[id]; }
+  float getCellSize() const { return float(CELL); }
 };
@@ -0,0 +1,198 @@
+// Headless batch analysis: searches every position of an EPD file and prints
+// one line per position with the best move, score, depth, nodes and
+// nodes/sec. Positions are spread over a pool of worker threads, each
+// running its own single-threaded search on the shared hash table; results
+// are printed in file order as soon as they are ready. The whole batch is
+// one hash table generation, so a search does not age out the entries of
+// the ones running beside it.
+//
+//   ./analyze <file.epd> [--movetime <ms>] [--depth <plies>] [--nodes <n>]
+//             [--jobs <threads>] [--hash <MB>] [--syzygy <dir>]
+//             [--nnue <file.nnue>]
+//
+// With no limit given each position gets one second.
+
+#include "Moves.h"
+#include "fen.h"
+#include "minimax.h"
+#include "nnue.h"
+#include "tablebase.h"
+#include "transposition.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Position {
+  std::string epd;
+  std::string id; // the EPD's id operation, or its line number
+  GameState state;
+  bool valid = false;
+};
+
+// Value of an EPD operation such as `id "WAC.001";`, without the quotes.
+static std::string epdOperation(const std::string &epd, const std::string &op) {
+  std::istringstream in(epd);
+  std::string field;
+  for (int i = 0; i < 4; ++i)
+    in >> field; // placement, side, castling, en passant
+
+  std::string rest;
+  std::getline(in, rest);
+  std::size_t at = rest.find(op + " ");
+  if (at == std::string::npos)
+    return "";
+  std::size_t start = at + op.size() + 1;
+  std::size_t end = rest.find(';', start);
+  std::string value = rest.substr(start, end - start);
+  value.erase(std::remove(value.begin(), value.end(), '"'), value.end());
+  return value;
+}
+
+static std::vector<Position> readEPD(std::istream &in) {
+  std::vector<Position> positions;
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(in, line)) {
+    ++lineNumber;
+    if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#')
+      continue;
+
+    Position pos;
+    pos.epd = line;
+    pos.id = epdOperation(line, "id");
+    if (pos.id.empty())
+      pos.id = "line " + std::to_string(lineNumber);
+    pos.valid = parseFEN(line, pos.state);
+    positions.push_back(pos);
+  }
+  return positions;
+}
+
+static std::string analyse(Position &pos, const SearchLimits &limits,
+                           std::atomic<unsigned long long> &totalNodes) {
+  std::ostringstream out;
+  out << pos.id << ": ";
+  if (!pos.valid) {
+    out << "error: bad position";
+    return out.str();
+  }
+
+  SearchStats stats;
+  evaluatedMove best =
+      Minimax(pos.state, pos.state.sideToMove, limits, &stats);
+  totalNodes += stats.nodes;
+  if (best.move == MOVE_NONE) {
+    out << "no legal moves, score " << best.score;
+    return out.str();
+  }
+  out << "bestmove " << moveToString(best.move) << " score " << best.score
+      << " depth " << stats.depth << " nodes " << stats.nodes << " nps "
+      << stats.nodesPerSecond();
+  if (stats.tbHits)
+    out << " tbhits " << stats.tbHits;
+  return out.str();
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    std::cerr << "usage: analyze <file.epd> [--movetime <ms>] [--depth <n>] "
+                 "[--nodes <n>] [--jobs <n>] [--hash <MB>] [--syzygy <dir>] "
+                 "[--nnue <file>]"
+              << std::endl;
+    return 1;
+  }
+
+  SearchLimits limits;
+  limits.threads = 1; // parallelism comes from searching positions side by side
+  limits.newGeneration = false; // one generation for the batch, below
+  int jobs = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 2; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    long long value;
+    if (flag == "--movetime" || flag == "--depth" || flag == "--nodes" ||
+        flag == "--jobs" || flag == "--hash") {
+      const long long max =
+          flag == "--depth" || flag == "--jobs" ? INT_MAX : LLONG_MAX;
+      if (!parseCount(argv[i + 1], max, value))
+        std::cerr << "Bad value for " << flag << std::endl;
+      else if (flag == "--movetime")
+        limits.moveTimeMs = value;
+      else if (flag == "--depth")
+        limits.depth = int(value);
+      else if (flag == "--nodes")
+        limits.nodes = value;
+      else if (flag == "--jobs")
+        jobs = std::max(1, int(value));
+      else
+        TT.resize(value);
+    } else if (flag == "--syzygy") {
+      if (initTablebases(argv[i + 1]) == 0)
+        std::cerr << "No tablebases in " << argv[i + 1] << std::endl;
+    } else if (flag == "--nnue") {
+      if (!NNUE.load(argv[i + 1]))
+        std::cerr << "Cannot load network " << argv[i + 1] << std::endl;
+    } else
+      std::cerr << "Unknown option " << flag << std::endl;
+  }
+  if (!limits.moveTimeMs && !limits.depth && !limits.nodes)
+    limits.moveTimeMs = 1000;
+
+  std::ifstream file(argv[1]);
+  if (!file) {
+    std::cerr << "Cannot open " << argv[1] << std::endl;
+    return 1;
+  }
+  std::vector<Position> positions = readEPD(file);
+  jobs = std::min<int>(jobs, std::max<std::size_t>(positions.size(), 1));
+  std::cout << positions.size() << " positions, " << jobs << " jobs"
+            << std::endl;
+
+  // Workers take the next position off a shared counter. Finished lines wait
+  // in `lines` until every earlier one has been printed.
+  std::atomic<std::size_t> next{0};
+  std::vector<std::string> lines(positions.size());
+  std::vector<bool> done(positions.size(), false);
+  std::size_t printed = 0;
+  std::mutex outputMutex;
+  std::atomic<unsigned long long> totalNodes{0};
+
+  TT.newSearch();
+  const auto start = std::chrono::steady_clock::now();
+  auto worker = [&] {
+    for (std::size_t i = next++; i < positions.size(); i = next++) {
+      std::string line = analyse(positions[i], limits, totalNodes);
+
+      std::lock_guard<std::mutex> lock(outputMutex);
+      lines[i] = line;
+      done[i] = true;
+      for (; printed < positions.size() && done[printed]; ++printed)
+        std::cout << lines[printed] << std::endl;
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (int i = 1; i < jobs; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (std::thread &t : pool)
+    t.join();
+
+  const long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  std::cout << "done: " << positions.size() << " positions, " << totalNodes
+            << " nodes in " << ms << " ms ("
+            << totalNodes * 1000 / (ms > 0 ? ms : 1) << " nodes/sec)"
+            << std::endl;
+  return 0;
+}
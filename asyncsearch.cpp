@@ -0,0 +1,50 @@
+#include "asyncsearch.h"
+
+#include <chrono>
+
+void AsyncSearch::start(const GameState &state, int side,
+                        const SearchLimits &limits) {
+  cancel();
+  cancelFlag = false;
+
+  SearchLimits jobLimits = limits;
+  jobLimits.cancel = &cancelFlag;
+  jobLimits.onProgress = [this](const SearchProgress &progress) {
+    std::lock_guard<std::mutex> lock(progressMutex);
+    latest = progress;
+  };
+
+  result = std::async(std::launch::async, [state, side, jobLimits] {
+    Result done;
+    done.move = Minimax(state, side, jobLimits, &done.stats);
+    return done;
+  });
+}
+
+void AsyncSearch::cancel() {
+  if (!result.valid())
+    return;
+  cancelFlag = true;
+  result.get();
+
+  std::lock_guard<std::mutex> lock(progressMutex);
+  latest = SearchProgress();
+}
+
+bool AsyncSearch::poll(evaluatedMove &move, SearchStats &stats) {
+  if (!result.valid() || result.wait_for(std::chrono::seconds(0)) !=
+                             std::future_status::ready)
+    return false;
+  Result done = result.get();
+  move = done.move;
+  stats = done.stats;
+
+  std::lock_guard<std::mutex> lock(progressMutex);
+  latest = SearchProgress();
+  return true;
+}
+
+SearchProgress AsyncSearch::progress() const {
+  std::lock_guard<std::mutex> lock(progressMutex);
+  return latest;
+}
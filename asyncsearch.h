@@ -0,0 +1,44 @@
+#pragma once
+#include "minimax.h"
+
+#include <atomic>
+#include <future>
+#include <mutex>
+
+// Runs Minimax on a worker thread so the caller (the GUI's event loop) stays
+// responsive. The caller starts a search, polls for the result, and can
+// cancel it at any time; progress from each finished iteration can be read
+// from any thread while it runs.
+class AsyncSearch {
+public:
+  ~AsyncSearch() { cancel(); }
+
+  // Searches a copy of `state` for `side`. Cancels any search still running.
+  void start(const GameState &state, int side, const SearchLimits &limits);
+
+  // Stops the running search, if any, waits for the worker and throws its
+  // result away.
+  void cancel();
+
+  // Whether a search has been started and its result not yet collected.
+  bool busy() const { return result.valid(); }
+
+  // Returns true, once, when the search has finished, filling in its result.
+  bool poll(evaluatedMove &move, SearchStats &stats);
+
+  // The last iteration the running search finished (depth 0 before the
+  // first one, or when no search is running). Safe to call from any thread.
+  SearchProgress progress() const;
+
+private:
+  struct Result {
+    evaluatedMove move;
+    SearchStats stats;
+  };
+
+  std::future<Result> result;
+  std::atomic<bool> cancelFlag{false};
+
+  mutable std::mutex progressMutex;
+  SearchProgress latest;
+};
@@ -0,0 +1,177 @@
+// Headless search benchmark. Searches a fixed set of positions to a fixed
+// depth with an increasing number of threads and prints nodes/sec and the
+// speedup over one thread, both in raw speed (nodes/sec) and in time taken
+// to reach the depth, which is what Lazy SMP actually buys. It also counts
+// heap allocations made inside the searches, which should be zero with one
+// thread and one per helper thread (std::thread's own) otherwise, plus one
+// per thread for the accumulators with a network. The first
+// row is followed by its beta cutoffs per remaining depth and the share that
+// came from the first move searched, to judge the move ordering.
+//
+//   ./bench [depth] [threads...]      defaults: depth 7, threads 1 2 4 8 16
+//           [--nnue <file.nnue>] [--kernels avx2|sse4.1|scalar]
+//
+// With a network the searches evaluate with it, so comparing against a run
+// without one shows what NNUE costs in nodes/sec. What it gains in strength
+// takes games at a fixed time per move, which this does not play.
+
+#include "Moves.h"
+#include "fen.h"
+#include "minimax.h"
+#include "nnue.h"
+#include "transposition.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+// Replaces the plain and the aligned operator new, each counted, and the four
+// single-object deletes that free what they return. The array and nothrow
+// forms of new and delete fall back to these by default, so every heap
+// allocation in the program is counted, the standard library's included.
+static std::atomic<unsigned long long> allocations{0};
+
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  // aligned_alloc takes a whole number of alignments
+  const std::size_t align = static_cast<std::size_t>(alignment);
+  const std::size_t rounded = (size + align - 1) / align * align;
+  if (void *p = std::aligned_alloc(align, rounded ? rounded : align))
+    return p;
+  throw std::bad_alloc();
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+static const char *const BENCH_POSITIONS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w - - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w - - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w - - 4 4",
+    "r2q1rk1/pp2bppp/2n1pn2/2pp4/3P4/2PBPN2/PP1N1PPP/R2QK2R w - - 0 9",
+    "2r3k1/pp3ppp/2n1p3/3pPn2/3P4/P1N2N2/1P3PPP/2R3K1 w - - 0 20",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "6k1/5p2/6p1/8/7p/8/6PP/6K1 b - - 0 1",
+};
+
+int main(int argc, char *argv[]) {
+  int depth = 7;
+  std::vector<int> threadCounts;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--nnue" && i + 1 < argc) {
+      if (!NNUE.load(argv[++i])) {
+        std::cerr << "cannot load network " << argv[i] << std::endl;
+        return 1;
+      }
+    } else if (arg == "--kernels" && i + 1 < argc) {
+      if (!NNUE.selectKernels(argv[++i])) {
+        std::cerr << "kernels " << argv[i] << " not available" << std::endl;
+        return 1;
+      }
+    } else {
+      // the depth first, then the thread counts
+      long long value;
+      const long long max = i == 1 ? MAX_DEPTH : MAX_THREADS;
+      if (!parseCount(argv[i], max, value) || value == 0) {
+        std::cerr << "bad " << (i == 1 ? "depth " : "thread count ")
+                  << argv[i] << std::endl;
+        return 1;
+      }
+      if (i == 1)
+        depth = int(value);
+      else
+        threadCounts.push_back(int(value));
+    }
+  }
+  if (threadCounts.empty())
+    threadCounts = {1, 2, 4, 8, 16};
+
+  if (NNUE.isLoaded())
+    std::cout << "evaluation: NNUE (" << NNUE.kernelName() << " kernels)"
+              << std::endl;
+  else
+    std::cout << "evaluation: handcrafted" << std::endl;
+
+  std::cout << "threads        nodes    time(ms)    nodes/sec   nps x  "
+               "time-to-depth x   allocs"
+            << std::endl;
+
+  double baseNps = 0, baseMs = 0;
+  SearchStats ordering; // cutoff counts of the first row
+  for (int threads : threadCounts) {
+    unsigned long long nodes = 0, allocs = 0;
+    long long ms = 0;
+
+    for (const char *fen : BENCH_POSITIONS) {
+      GameState state;
+      if (!parseFEN(fen, state)) {
+        std::cerr << "bad FEN: " << fen << std::endl;
+        return 1;
+      }
+      TT.clear(); // every run starts cold so the thread counts compare fairly
+
+      SearchLimits limits;
+      limits.depth = depth;
+      limits.threads = threads;
+      SearchStats stats;
+
+      const unsigned long long allocsBefore = allocations.load();
+      Minimax(state, state.sideToMove, limits, &stats);
+      allocs += allocations.load() - allocsBefore;
+
+      nodes += stats.nodes;
+      ms += stats.elapsedMs;
+      if (threads == threadCounts[0]) {
+        ordering.cutoffs += stats.cutoffs;
+        for (int d = 0; d <= MAX_DEPTH; ++d) {
+          ordering.cutoffsAtDepth[d] += stats.cutoffsAtDepth[d];
+          ordering.firstMoveCutoffsAtDepth[d] +=
+              stats.firstMoveCutoffsAtDepth[d];
+        }
+      }
+    }
+
+    const double nps = nodes * 1000.0 / (ms > 0 ? ms : 1);
+    if (baseNps == 0) {
+      baseNps = nps;
+      baseMs = ms > 0 ? ms : 1;
+    }
+    std::cout << std::setw(7) << threads << std::setw(13) << nodes
+              << std::setw(12) << ms << std::setw(13) << (long long)nps
+              << std::fixed << std::setprecision(2) << std::setw(8)
+              << nps / baseNps << std::setw(17) << baseMs / (ms > 0 ? ms : 1)
+              << std::setw(9) << allocs << std::endl;
+
+    if (threads == threadCounts[0]) {
+      std::cout << "  depth      cutoffs  first move" << std::endl;
+      for (int d = 1; d <= MAX_DEPTH; ++d) {
+        if (!ordering.cutoffsAtDepth[d])
+          continue;
+        std::cout << std::setw(7) << d << std::setw(13)
+                  << ordering.cutoffsAtDepth[d] << std::setw(11)
+                  << 100.0 * ordering.firstMoveCutoffsAtDepth[d] /
+                         ordering.cutoffsAtDepth[d]
+                  << "%" << std::endl;
+      }
+      std::cout << "    all" << std::setw(13) << ordering.cutoffs
+                << std::setw(11) << ordering.firstMoveCutoffRate() << "%"
+                << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,214 @@
+#include "bitboards.h"
+
+#include <initializer_list>
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
+Bitboard pawnAttacks[2][64];
+Bitboard knightAttacks[64];
+Bitboard kingAttacks[64];
+Bitboard betweenBB[64][64];
+Bitboard lineBB[64][64];
+
+namespace {
+
+struct Magic {
+  Bitboard mask;
+  Bitboard magic;
+  Bitboard *attacks;
+  unsigned shift;
+
+  unsigned index(Bitboard occupied) const {
+#ifdef USE_PEXT
+    return (unsigned)_pext_u64(occupied, mask);
+#else
+    return (unsigned)(((occupied & mask) * magic) >> shift);
+#endif
+  }
+};
+
+Magic rookMagics[64];
+Magic bishopMagics[64];
+
+// 4096 slots for the worst rook square (12 relevant bits) down to 1024, and
+// 512 down to 32 for bishops; these are the exact totals over all squares.
+Bitboard rookTable[0x19000];
+Bitboard bishopTable[0x1480];
+
+const int rookDirs[4][2] = {{+1, 0}, {-1, 0}, {0, +1}, {0, -1}};
+const int bishopDirs[4][2] = {{+1, +1}, {+1, -1}, {-1, +1}, {-1, -1}};
+
+inline bool inBounds(int x, int y) {
+  return x >= 0 && x < 8 && y >= 0 && y < 8;
+}
+
+// Walks each ray square by square. Only used to build the tables.
+Bitboard slidingAttacks(int sq, Bitboard occupied, const int (&dirs)[4][2]) {
+  Bitboard attacks = 0;
+  for (const auto &d : dirs) {
+    int x = fileOf(sq) + d[0];
+    int y = rowOf(sq) + d[1];
+    while (inBounds(x, y)) {
+      attacks |= squareBB(squareOf(x, y));
+      if (occupied & squareBB(squareOf(x, y)))
+        break; // blocked
+      x += d[0];
+      y += d[1];
+    }
+  }
+  return attacks;
+}
+
+// xorshift64*; fixed seeds keep the magics identical from run to run
+struct Prng {
+  uint64_t s;
+  uint64_t next() {
+    s ^= s >> 12;
+    s ^= s << 25;
+    s ^= s >> 27;
+    return s * 2685821657736338717ULL;
+  }
+  uint64_t sparse() { return next() & next() & next(); }
+};
+
+void initMagics(Magic (&magics)[64], Bitboard *table,
+                const int (&dirs)[4][2]) {
+  static Bitboard occupancy[4096], reference[4096];
+  static int epoch[4096];
+  static int attempt = 0; // shared with epoch[] across both calls
+  // One seed per row; these were picked by trying the first few thousand
+  // seeds and keeping the one that finds that row's magics fastest.
+  static const uint64_t seeds[8] = {728,  2985, 786,  2501,
+                                    2009, 2821, 1699, 255};
+  Prng rng{0};
+
+  for (int sq = 0; sq < 64; ++sq) {
+    Magic &m = magics[sq];
+
+    // The outermost square of each ray never changes the attack set, so it
+    // is left out of the mask.
+    Bitboard edges = 0;
+    if (rowOf(sq) != 0)
+      edges |= 0xFFULL;
+    if (rowOf(sq) != 7)
+      edges |= 0xFFULL << 56;
+    if (fileOf(sq) != 0)
+      edges |= 0x0101010101010101ULL;
+    if (fileOf(sq) != 7)
+      edges |= 0x8080808080808080ULL;
+
+    m.mask = slidingAttacks(sq, 0, dirs) & ~edges;
+    m.shift = 64 - popCount(m.mask);
+    m.attacks = sq == 0 ? table : magics[sq - 1].attacks +
+                                      (1u << (64 - magics[sq - 1].shift));
+
+    // enumerate every subset of the mask (Carry-Rippler)
+    int size = 0;
+    Bitboard b = 0;
+    do {
+      occupancy[size] = b;
+      reference[size] = slidingAttacks(sq, b, dirs);
+      ++size;
+      b = (b - m.mask) & m.mask;
+    } while (b);
+
+#ifdef USE_PEXT
+    for (int i = 0; i < size; ++i)
+      m.attacks[m.index(occupancy[i])] = reference[i];
+#else
+    // Try sparse random multipliers until one maps every subset to a slot
+    // without two different attack sets colliding.
+    rng.s = seeds[rowOf(sq)];
+    for (int i = 0; i < size;) {
+      do {
+        m.magic = rng.sparse();
+      } while (popCount((m.mask * m.magic) >> 56) < 6);
+
+      ++attempt;
+      for (i = 0; i < size; ++i) {
+        unsigned idx = m.index(occupancy[i]);
+        if (epoch[idx] < attempt) {
+          epoch[idx] = attempt;
+          m.attacks[idx] = reference[i];
+        } else if (m.attacks[idx] != reference[i]) {
+          break;
+        }
+      }
+    }
+#endif
+  }
+}
+
+void initLeapers() {
+  static const int knightJumps[8][2] = {{+1, +2}, {+2, +1}, {+2, -1},
+                                        {+1, -2}, {-1, -2}, {-2, -1},
+                                        {-2, +1}, {-1, +2}};
+  for (int sq = 0; sq < 64; ++sq) {
+    const int x = fileOf(sq);
+    const int y = rowOf(sq);
+
+    for (int dx : {-1, +1}) {
+      if (inBounds(x + dx, y - 1))
+        pawnAttacks[0][sq] |= squareBB(squareOf(x + dx, y - 1));
+      if (inBounds(x + dx, y + 1))
+        pawnAttacks[1][sq] |= squareBB(squareOf(x + dx, y + 1));
+    }
+
+    for (const auto &j : knightJumps) {
+      if (inBounds(x + j[0], y + j[1]))
+        knightAttacks[sq] |= squareBB(squareOf(x + j[0], y + j[1]));
+    }
+
+    for (int dy = -1; dy <= 1; ++dy) {
+      for (int dx = -1; dx <= 1; ++dx) {
+        if ((dx || dy) && inBounds(x + dx, y + dy))
+          kingAttacks[sq] |= squareBB(squareOf(x + dx, y + dy));
+      }
+    }
+  }
+}
+
+// Needs the slider tables, so it runs after initMagics.
+void initLines() {
+  for (int a = 0; a < 64; ++a) {
+    for (int b = 0; b < 64; ++b) {
+      if (a == b)
+        continue;
+      const Bitboard ends = squareBB(a) | squareBB(b);
+      if (rookAttacks(a, 0) & squareBB(b)) {
+        lineBB[a][b] = (rookAttacks(a, 0) & rookAttacks(b, 0)) | ends;
+        betweenBB[a][b] =
+            rookAttacks(a, squareBB(b)) & rookAttacks(b, squareBB(a));
+      } else if (bishopAttacks(a, 0) & squareBB(b)) {
+        lineBB[a][b] = (bishopAttacks(a, 0) & bishopAttacks(b, 0)) | ends;
+        betweenBB[a][b] =
+            bishopAttacks(a, squareBB(b)) & bishopAttacks(b, squareBB(a));
+      }
+    }
+  }
+}
+
+// Tables are built once before main() runs, so every user (GUI, search,
+// headless tools) can use them without an explicit init call.
+struct TableInit {
+  TableInit() {
+    initLeapers();
+    initMagics(rookMagics, rookTable, rookDirs);
+    initMagics(bishopMagics, bishopTable, bishopDirs);
+    initLines();
+  }
+} tableInit;
+
+} // namespace
+
+Bitboard rookAttacks(int sq, Bitboard occupied) {
+  const Magic &m = rookMagics[sq];
+  return m.attacks[m.index(occupied)];
+}
+
+Bitboard bishopAttacks(int sq, Bitboard occupied) {
+  const Magic &m = bishopMagics[sq];
+  return m.attacks[m.index(occupied)];
+}
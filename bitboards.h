@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+
+// One bit per square. Squares are numbered the same way GameState::board is
+// laid out: sq = y * 8 + x, so bit 0 is a8 (top left of the window) and bit
+// 63 is h1.
+typedef uint64_t Bitboard;
+
+constexpr int squareOf(int x, int y) { return y * 8 + x; }
+constexpr int fileOf(int sq) { return sq & 7; }
+constexpr int rowOf(int sq) { return sq >> 3; }
+constexpr Bitboard squareBB(int sq) { return 1ULL << sq; }
+
+inline int popCount(Bitboard b) { return __builtin_popcountll(b); }
+inline int lsb(Bitboard b) { return __builtin_ctzll(b); }
+inline int popLsb(Bitboard &b) {
+  int sq = lsb(b);
+  b &= b - 1;
+  return sq;
+}
+
+// Leaper attack tables, indexed by square. pawnAttacks is also indexed by
+// colour (0 = white, moving up the board; 1 = black, moving down).
+extern Bitboard pawnAttacks[2][64];
+extern Bitboard knightAttacks[64];
+extern Bitboard kingAttacks[64];
+
+// Slider attacks for the given occupancy, looked up through magic bitboards
+// (or PEXT when built with -DUSE_PEXT on a BMI2 machine).
+Bitboard rookAttacks(int sq, Bitboard occupied);
+Bitboard bishopAttacks(int sq, Bitboard occupied);
+inline Bitboard queenAttacks(int sq, Bitboard occupied) {
+  return rookAttacks(sq, occupied) | bishopAttacks(sq, occupied);
+}
+
+// Squares strictly between two squares on a shared rank, file or diagonal,
+// and the whole line through them (both ends included). Zero when the
+// squares are not aligned.
+extern Bitboard betweenBB[64][64];
+extern Bitboard lineBB[64][64];
@@ -0,0 +1,58 @@
+#pragma once
+#include "Moves.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A Polyglot opening book (.bin). The file is a sorted array of 16-byte
+// big-endian entries {key, move, weight, learn}, several per position, so a
+// position's moves are found by binary search on its key. The file is
+// memory-mapped read-only rather than loaded: opening it costs nothing and
+// processes using the same book share its pages.
+class OpeningBook {
+public:
+  OpeningBook() = default;
+  OpeningBook(const OpeningBook &) = delete;
+  OpeningBook &operator=(const OpeningBook &) = delete;
+  ~OpeningBook() { close(); }
+
+  // Maps the book at `path`, replacing any open one. Returns false (and
+  // leaves no book open) if it can't be read or is not a whole number of
+  // entries.
+  bool open(const std::string &path);
+  void close();
+  bool isOpen() const { return count > 0; }
+  std::size_t size() const { return count; }
+
+  // A legal book move for `state`, picked at random with probability
+  // proportional to its weight. Returns false if the book has none.
+  bool probe(const GameState &state, Move &move) const;
+
+  // The legal book moves for `state` and their weights, best first; returns
+  // how many were written (at most `max`).
+  int entries(const GameState &state, Move *moves, int *weights,
+              int max) const;
+
+private:
+  const unsigned char *data = nullptr;
+  std::size_t count = 0; // entries
+};
+
+// The book the front ends probe before searching; closed unless a book file
+// was given.
+extern OpeningBook BOOK;
+
+// Polyglot's hash of `state`: one random number per (piece, square), per
+// castling right, per en passant file (only when a pawn can take) and for
+// white to move, XORed together.
+uint64_t polyglotKey(const GameState &state);
+
+// Whether polyglotKey gives the start position its published key, i.e. the
+// random number table in book.cpp is intact.
+bool hasStandardPolyglotKeys();
+
+// Polyglot's move encoding for `move`: to file/rank in bits 0-5, from
+// file/rank in bits 6-11, promotion piece in 12-14, castling as the king
+// taking its own rook (e1h1).
+uint16_t polyglotMove(const Move &move);
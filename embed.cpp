@@ -0,0 +1,47 @@
+// Build-time tool: writes a C++ source file that compiles the given files
+// into the program as an array of EmbeddedFile (declared in `header`), in
+// the order they are listed.
+//
+//   ./embed <header> <array name> <files...> > out.cpp
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    std::cerr << "usage: embed <header> <array name> <files...>" << std::endl;
+    return 1;
+  }
+
+  std::cout << "// Generated by embed from the files below. Do not edit.\n"
+            << "#include \"" << argv[1] << "\"\n\n";
+
+  const int count = argc - 3;
+  for (int i = 0; i < count; ++i) {
+    std::ifstream in(argv[i + 3], std::ios::binary);
+    if (!in) {
+      std::cerr << "embed: cannot read " << argv[i + 3] << std::endl;
+      return 1;
+    }
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(in)),
+                                     std::istreambuf_iterator<char>());
+
+    std::cout << "// " << argv[i + 3] << "\n"
+              << "static const unsigned char file" << i << "[] = {";
+    for (std::size_t b = 0; b < bytes.size(); ++b) {
+      char hex[8];
+      std::snprintf(hex, sizeof(hex), "0x%02x,", bytes[b]);
+      std::cout << (b % 12 == 0 ? "\n    " : " ") << hex;
+    }
+    std::cout << "\n};\n\n";
+  }
+
+  std::cout << "const EmbeddedFile " << argv[2] << "[" << count << "] = {\n";
+  for (int i = 0; i < count; ++i)
+    std::cout << "    {file" << i << ", sizeof(file" << i << ")},\n";
+  std::cout << "};\n";
+  return 0;
+}
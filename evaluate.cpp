@@ -0,0 +1,40 @@
+#include "evaluate.h"
+
+#ifdef DEBUG_EVAL
+#include <cstdlib>
+#include <iostream>
+#endif
+
+void computeEvalTotals(const GameState &state, int (&material)[2],
+                       int (&positional)[2]) {
+  material[0] = material[1] = 0;
+  positional[0] = positional[1] = 0;
+  Bitboard occupied = state.occupied;
+  while (occupied) {
+    const int sq = popLsb(occupied);
+    const int piece = state.board[sq];
+    material[colorOf(piece)] += PIECE_VALUES[piece];
+    positional[colorOf(piece)] += PST.value[piece][sq];
+  }
+}
+
+int evaluateScore(const GameState &state, int color) {
+  // Given a game state, return an integer value for the score of the game
+#ifdef DEBUG_EVAL
+  int material[2], positional[2];
+  computeEvalTotals(state, material, positional);
+  if (material[0] != state.material[0] || material[1] != state.material[1] ||
+      positional[0] != state.positional[0] ||
+      positional[1] != state.positional[1]) {
+    std::cerr << "incremental eval out of sync: material " << state.material[0]
+              << "/" << state.material[1] << " vs " << material[0] << "/"
+              << material[1] << ", positional " << state.positional[0] << "/"
+              << state.positional[1] << " vs " << positional[0] << "/"
+              << positional[1] << std::endl;
+    std::abort();
+  }
+#endif
+  const int enemy = color ^ 1;
+  return (state.material[color] + state.positional[color]) -
+         (state.material[enemy] + state.positional[enemy]);
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include "Moves.h"
+#include "pieces.h"
+
+// Handcrafted evaluation: material plus piece-square tables. GameState keeps
+// both totals per colour, updated by doMove/undoMove as pieces move, so a
+// leaf costs a couple of subtractions instead of a 64-square scan. With a
+// network loaded (see nnue.h) the search evaluates with that instead.
+
+// Array for values of pieces, indexed by PieceIDs
+// 0: Empty
+// 1-6:  W_PAWN, W_ROOK, W_KNIGHT, W_BISHOP, W_QUEEN, W_KING
+// 7-12: B_PAWN, B_ROOK, B_KNIGHT, B_BISHOP, B_QUEEN, B_KING
+
+inline constexpr int PIECE_VALUES[13] = {
+    0,     // EMPTY
+    100,   // W_PAWN
+    500,   // W_ROOK
+    320,   // W_KNIGHT
+    330,   // W_BISHOP
+    900,   // W_QUEEN
+    20000, // W_KING (Arbitrarily high so the engine never sacrifices it)
+    100,   // B_PAWN
+    500,   // B_ROOK
+    320,   // B_KNIGHT
+    330,   // B_BISHOP
+    900,   // B_QUEEN
+    20000  // B_KING
+};
+
+// --------------------------------------------------------------------------
+// PIECE-SQUARE TABLES (White's Perspective)
+// --------------------------------------------------------------------------
+// These are flat arrays of 64 integers.
+// Access them using: table[y * 8 + x]
+
+// PAWNS: Encourage moving forward and controlling the center (d4/e4).
+inline constexpr int pawn_pst[64] = {
+    0,   0,   0,   0,
+    0,   0,   0,   0, // Rank 8 (Promoted - usually irrelevant here)
+    50,  50,  50,  50,
+    50,  50,  50,  50, // Rank 7 (Almost promoted!)
+    10,  10,  20,  30,
+    30,  20,  10,  10, // Rank 6
+    5,   5,   10,  25,
+    25,  10,  5,   5, // Rank 5
+    0,   0,   0,   20,
+    20,  0,   0,   0, // Rank 4
+    5,   -5,  -10, 0,
+    0,   -10, -5,  5, // Rank 3
+    5,   10,  10,  -20,
+    -20, 10,  10,  5, // Rank 2 (Don't move f/g/h pawns too early)
+    0,   0,   0,   0,
+    0,   0,   0,   0 // Rank 1 (Base)
+};
+
+// KNIGHTS: Strong in the center, terrible at the edges/corners.
+inline constexpr int knight_pst[64] = {
+    -50, -40, -30, -30, -30, -30, -40, -50, -40, -20, 0,   0,   0,
+    0,   -20, -40, -30, 0,   10,  15,  15,  10,  0,   -30, -30, 5,
+    15,  20,  20,  15,  5,   -30, -30, 0,   15,  20,  20,  15,  0,
+    -30, -30, 5,   10,  15,  15,  10,  5,   -30, -40, -20, 0,   5,
+    5,   0,   -20, -40, -50, -40, -30, -30, -30, -30, -40, -50};
+
+// BISHOPS: Good on long diagonals, better in center than corners.
+inline constexpr int bishop_pst[64] = {
+    -20, -10, -10, -10, -10, -10, -10, -20, -10, 0,   0,   0,   0,
+    0,   0,   -10, -10, 0,   5,   10,  10,  5,   0,   -10, -10, 5,
+    5,   10,  10,  5,   5,   -10, -10, 0,   10,  10,  10,  10,  0,
+    -10, -10, 10,  10,  10,  10,  10,  10,  -10, -10, 5,   0,   0,
+    0,   0,   5,   -10, -20, -10, -10, -10, -10, -10, -10, -20};
+
+// ROOKS: Bonus for 7th rank (attacking enemy pawns) and centering.
+inline constexpr int rook_pst[64] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 5, 10, 10, 10, 10, 10, 10, 5, // 7th Rank (Pig
+                                                          // on the 7th)
+    -5, 0, 0, 0, 0, 0, 0, -5, -5, 0, 0, 0, 0, 0, 0, -5, -5, 0, 0, 0, 0, 0, 0,
+    -5, -5, 0, 0, 0, 0, 0, 0, -5, -5, 0, 0, 0, 0, 0, 0, -5, 0, 0, 0, 5, 5, 0, 0,
+    0 // Castling squares
+      // slightly better
+};
+
+// QUEENS: Generally kept simple. Avoid corners, stay somewhat central.
+inline constexpr int queen_pst[64] = {
+    -20, -10, -10, -5, -5, -10, -10, -20, -10, 0,   0,   0,  0,  0,   0,   -10,
+    -10, 0,   5,   5,  5,  5,   0,   -10, -5,  0,   5,   5,  5,  5,   0,   -5,
+    0,   0,   5,   5,  5,  5,   0,   -5,  -10, 5,   5,   5,  5,  5,   0,   -10,
+    -10, 0,   5,   0,  0,  0,   0,   -10, -20, -10, -10, -5, -5, -10, -10, -20};
+
+// KINGS (MIDDLE GAME): Highly penalized for being in the center or open files.
+// Encourages castling into the corners (g1/b1).
+inline constexpr int king_pst[64] = {
+    -30, -40, -40, -50, -50, -40, -40, -30, -30, -40, -40, -50, -50, -40, -40,
+    -30, -30, -40, -40, -50, -50, -40, -40, -30, -30, -40, -40, -50, -50, -40,
+    -40, -30, -20, -30, -30, -40, -40, -30, -30, -20, -10, -20, -20, -20, -20,
+    -20, -20, -10, 20,  20,  0,   0,   0,   0,   20,  20, // Pawn shield rank
+    20,  30,  10,  0,   0,   10,  30,  20 // Back rank (Corners are safest)
+};
+
+// --------------------------------------------------------------------------
+// FLAT PIECE-SQUARE TABLE
+// --------------------------------------------------------------------------
+// PST.value[piece][sq] is the positional bonus for `piece` (a PieceIDs value)
+// standing on square sq = y * 8 + x, with Black's tables mirrored vertically.
+// Built at compile time from the per-piece tables above.
+
+struct PieceSquareTable {
+  int value[13][64];
+};
+
+constexpr const int *tableFor(int piece) {
+  switch (piece > W_KING ? piece - 6 : piece) {
+  case W_PAWN:
+    return pawn_pst;
+  case W_KNIGHT:
+    return knight_pst;
+  case W_BISHOP:
+    return bishop_pst;
+  case W_ROOK:
+    return rook_pst;
+  case W_QUEEN:
+    return queen_pst;
+  case W_KING:
+    return king_pst;
+  default:
+    return nullptr;
+  }
+}
+
+constexpr PieceSquareTable buildPieceSquareTable() {
+  PieceSquareTable pst{};
+  for (int piece = W_PAWN; piece <= B_KING; ++piece) {
+    const int *table = tableFor(piece);
+    const bool white = piece <= W_KING;
+    for (int sq = 0; sq < 64; ++sq) {
+      const int x = sq % 8, y = sq / 8;
+      pst.value[piece][sq] = white ? table[y * 8 + x] : table[(7 - y) * 8 + x];
+    }
+  }
+  return pst;
+}
+
+inline constexpr PieceSquareTable PST = buildPieceSquareTable();
+
+// Score of the position for `color`: its material and positional totals
+// minus the opponent's. O(1); built with -DDEBUG_EVAL it also recomputes the
+// totals from the board and aborts if the incremental ones have drifted.
+int evaluateScore(const GameState &state, int color);
+
+// Recomputes the totals from the board; refreshGameState uses this, after
+// the bitboards.
+void computeEvalTotals(const GameState &state, int (&material)[2],
+                       int (&positional)[2]);
@@ -0,0 +1,200 @@
+#include "fen.h"
+#include "pieces.h"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+
+const char *const START_FEN =
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static int pieceFromChar(char c) {
+  switch (c) {
+  case 'P':
+    return W_PAWN;
+  case 'N':
+    return W_KNIGHT;
+  case 'B':
+    return W_BISHOP;
+  case 'R':
+    return W_ROOK;
+  case 'Q':
+    return W_QUEEN;
+  case 'K':
+    return W_KING;
+  case 'p':
+    return B_PAWN;
+  case 'n':
+    return B_KNIGHT;
+  case 'b':
+    return B_BISHOP;
+  case 'r':
+    return B_ROOK;
+  case 'q':
+    return B_QUEEN;
+  case 'k':
+    return B_KING;
+  default:
+    return EMPTY;
+  }
+}
+
+// Castling rights as FEN writes them, with the squares their king and rook
+// have to be on.
+struct CastlingField {
+  char symbol;
+  int right;
+  int king, kingSq;
+  int rook, rookSq;
+};
+
+static const CastlingField CASTLING_FIELDS[4] = {
+    {'K', CASTLE_WHITE_KINGSIDE, W_KING, 60, W_ROOK, 63},
+    {'Q', CASTLE_WHITE_QUEENSIDE, W_KING, 60, W_ROOK, 56},
+    {'k', CASTLE_BLACK_KINGSIDE, B_KING, 4, B_ROOK, 7},
+    {'q', CASTLE_BLACK_QUEENSIDE, B_KING, 4, B_ROOK, 0},
+};
+
+static std::string squareName(int sq) {
+  return {char('a' + fileOf(sq)), char('8' - rowOf(sq))};
+}
+
+// -1 if `name` is not a square such as e3.
+static int squareFromName(const std::string &name) {
+  if (name.size() != 2 || name[0] < 'a' || name[0] > 'h' || name[1] < '1' ||
+      name[1] > '8')
+    return -1;
+  return squareOf(name[0] - 'a', '8' - name[1]);
+}
+
+bool parseFEN(const std::string &fen, GameState &state) {
+  std::istringstream in(fen);
+  std::string placement, side, castling = "-", ep = "-";
+  if (!(in >> placement >> side))
+    return false;
+  in >> castling >> ep; // optional, for hand-written positions
+
+  GameState parsed{};
+  // FEN lists rank 8 first, which is row 0 of the board (a8 is square 0)
+  int x = 0, y = 0;
+  for (char c : placement) {
+    if (c == '/') {
+      if (x != 8)
+        return false;
+      ++y;
+      x = 0;
+    } else if (std::isdigit((unsigned char)c)) {
+      x += c - '0';
+    } else {
+      int piece = pieceFromChar(c);
+      if (piece == EMPTY || x > 7 || y > 7)
+        return false;
+      parsed.board[squareOf(x++, y)] = piece;
+    }
+    if (x > 8)
+      return false;
+  }
+  if (y != 7 || x != 8)
+    return false;
+
+  if (side != "w" && side != "b")
+    return false;
+  parsed.sideToMove = (side == "w") ? 0 : 1;
+
+  for (const CastlingField &field : CASTLING_FIELDS) {
+    if (castling.find(field.symbol) != std::string::npos &&
+        parsed.board[field.kingSq] ==
+            field.king &&
+        parsed.board[field.rookSq] == field.rook)
+      parsed.castling |= field.right;
+  }
+
+  parsed.epSquare = -1;
+  refreshGameState(parsed);
+
+  // the en passant square is kept only when a pawn of the side to move
+  // attacks it, as doMove does
+  const int epSquare = squareFromName(ep);
+  const int ownPawn = parsed.sideToMove == 0 ? W_PAWN : B_PAWN;
+  if (epSquare >= 0 && rowOf(epSquare) == (parsed.sideToMove == 0 ? 2 : 5) &&
+      (pawnAttacks[parsed.sideToMove ^ 1][epSquare] &
+       parsed.pieces[ownPawn])) {
+    parsed.epSquare = epSquare;
+    refreshGameState(parsed); // to hash it in
+  }
+
+  // a position without both kings cannot be searched
+  if (popCount(parsed.pieces[W_KING]) != 1 ||
+      popCount(parsed.pieces[B_KING]) != 1)
+    return false;
+
+  state = parsed;
+  return true;
+}
+
+std::string toFEN(const GameState &state) {
+  static const char PIECE_CHARS[] = " PRNBQKprnbqk"; // indexed by PieceIDs
+
+  std::string fen;
+  for (int y = 0; y < 8; ++y) {
+    int empty = 0;
+    for (int x = 0; x < 8; ++x) {
+      const int piece = state.board[squareOf(x, y)];
+      if (piece == EMPTY) {
+        ++empty;
+        continue;
+      }
+      if (empty)
+        fen += char('0' + empty);
+      empty = 0;
+      fen += PIECE_CHARS[piece];
+    }
+    if (empty)
+      fen += char('0' + empty);
+    if (y < 7)
+      fen += '/';
+  }
+  fen += state.sideToMove == 0 ? " w " : " b ";
+
+  std::string castling;
+  for (const CastlingField &field : CASTLING_FIELDS) {
+    if (state.castling & field.right)
+      castling += field.symbol;
+  }
+  fen += castling.empty() ? "-" : castling;
+  fen += " " + (state.epSquare >= 0 ? squareName(state.epSquare) : "-");
+  fen += " 0 1";
+  return fen;
+}
+
+std::string moveToString(const Move &move) {
+  std::string name = squareName(move.from()) + squareName(move.to());
+  if (move.isPromotion())
+    name += "nbrq"[move.flag() - MOVE_PROMOTE_KNIGHT];
+  return name;
+}
+
+bool parseMove(const std::string &name, const GameState &state, Move &move) {
+  MoveList moves;
+  generateAllMoves(state, moves);
+  for (const Move &legal : moves) {
+    if (moveToString(legal) == name) {
+      move = legal;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool parseCount(const std::string &text, long long max, long long &value) {
+  const char *start = text.c_str();
+  char *end;
+  errno = 0;
+  value = std::strtoll(start, &end, 10);
+  if (end == start || errno != 0)
+    return false;
+  while (std::isspace(static_cast<unsigned char>(*end)))
+    ++end;
+  return *end == '\0' && value >= 0 && value <= max;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "Moves.h"
+
+#include <string>
+
+// The standard starting position.
+extern const char *const START_FEN;
+
+// Sets `state` up from a FEN string (or the first four fields of an EPD
+// line). Castling rights whose king or rook is not on its home square are
+// dropped, as is an en passant square no pawn can capture on. The move
+// counters are accepted but ignored. Returns false (and leaves `state`
+// untouched) if the string is malformed.
+bool parseFEN(const std::string &fen, GameState &state);
+
+// The FEN of `state`. The move counters are always "0 1", as the game does
+// not track them.
+std::string toFEN(const GameState &state);
+
+// Coordinate notation, e.g. e2e4, e1g1 for castling and e7e8q for a
+// promotion (the form UCI uses).
+std::string moveToString(const Move &move);
+
+// The legal move of `state` written as `name` in coordinate notation. Returns
+// false if there is none.
+bool parseMove(const std::string &name, const GameState &state, Move &move);
+
+// A count given as text (a depth, a thread count, megabytes...): all of
+// `text` but surrounding blanks (so "2s" is not 2), from 0 to `max`.
+// Returns false if it is not one.
+bool parseCount(const std::string &text, long long max, long long &value);
@@ -1,6 +1,13 @@
 #include "Moves.h"
 #include "TextureManager.h"
+#include "asyncsearch.h"
+#include "book.h"
+#include "fen.h"
 #include "minimax.h"
+#include "nnue.h"
+#include "tablebase.h"
+#include "trace.h"
+#include "triplebuffer.h"
 #include <SFML/Graphics.hpp>
 #include <SFML/Graphics/CircleShape.hpp>
 #include <SFML/Graphics/Color.hpp>
@@ -12,84 +19,51 @@
 #include <SFML/Window/Mouse.hpp>
 #include <algorithm>
 #include <atomic>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
 #include <cstddef>
+#include <initializer_list>
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 
-std::string getTexturePath(int pieceId) {
-  switch (pieceId) {
-  case W_PAWN:
-    return "sprites/white-pawn.png";
-  case W_ROOK:
-    return "sprites/white-rook.png";
-  case W_KNIGHT:
-    return "sprites/white-knight.png";
-  case W_BISHOP:
-    return "sprites/white-bishop.png";
-  case W_QUEEN:
-    return "sprites/white-queen.png";
-  case W_KING:
-    return "sprites/white-king.png";
-
-  case B_PAWN:
-    return "sprites/black-pawn.png";
-  case B_ROOK:
-    return "sprites/black-rook.png";
-  case B_KNIGHT:
-    return "sprites/black-knight.png";
-  case B_BISHOP:
-    return "sprites/black-bishop.png";
-  case B_QUEEN:
-    return "sprites/black-queen.png";
-  case B_KING:
-    return "sprites/black-king.png";
-  default:
-    return "";
-  }
-}
-
 std::atomic<bool> running{true};
 
 enum turns { WHITE = 0, BLACK = 1 };
 enum modes { DEACTIVED = 0, MOVE = 1 };
 
-std::vector<sf::Texture> TEXTUREMAP = {};
-sf::Vector2i SELECTED = {-1, -1};
+Coord SELECTED = {-1, -1};
 
 int mode = DEACTIVED;
 std::vector<Move> moves;
-sf::Vector2i whiteKingPos;
-sf::Vector2i blackKingPos;
+Coord whiteKingPos;
+Coord blackKingPos;
+
+// Everything the renderer draws. The game loop builds one each time round
+// and hands it over through a TripleBuffer, so the render thread never reads
+// the game state while it is being changed.
+struct RenderFrame {
+  int8_t board[64] = {}; // as GameState::board
+  int placeholder[8][8] = {}; // 1 on the squares the selected piece can reach
+  Coord selected = {-1, -1};
+  bool thinking = false; // the AI is searching; bestMove is its current pick
+  Move bestMove;
+};
 
 static inline bool inBounds(int x, int y) {
   return x >= 0 && x < 8 && y >= 0 && y < 8;
 }
 
-void drawTile(sf::RenderWindow *win, sf::Color col, sf::Vector2f pos) {
-  sf::RectangleShape tile({150.0f, 150.0f});
-  tile.setFillColor(col);
-  tile.setPosition(pos);
-  win->draw(tile);
-}
-
-void drawPlaceholder(sf::RenderWindow *win, sf::Color col, sf::Vector2f pos) {
-  sf::CircleShape placeholder(20.0f);
-  placeholder.setFillColor(col);
-  placeholder.setPosition(pos);
-  win->draw(placeholder);
-}
-
-sf::Vector2i selectPiece(sf::Vector2i localPosition, GameState &current) {
-  sf::Vector2i coordinate = {(localPosition.x / 150), (localPosition.y / 150)};
-  int BOARD[8][8];
-  std::copy(&current.board[0][0], &current.board[0][0] + 64, &BOARD[0][0]);
+Coord selectPiece(sf::Vector2i localPosition, GameState &current) {
+  Coord coordinate = {(localPosition.x / 150), (localPosition.y / 150)};
   if (mode == DEACTIVED) {
 
     if (inBounds(coordinate.x, coordinate.y) &&
-        BOARD[coordinate.y][coordinate.x] != EMPTY) {
+        current.board[squareOf(coordinate.x, coordinate.y)] != EMPTY) {
 
-      int clicked = BOARD[coordinate.y][coordinate.x];
+      int clicked = current.board[squareOf(coordinate.x, coordinate.y)];
       if (clicked != EMPTY && colorOf(clicked) == current.sideToMove) {
         mode = MOVE;
         SELECTED = coordinate;
@@ -98,14 +72,25 @@ sf::Vector2i selectPiece(sf::Vector2i localPosition, GameState &current) {
 
     } else {
       mode = DEACTIVED;
-      return sf::Vector2i{-1, -1};
+      return Coord{-1, -1};
     }
   } else { // mode == MOVE
-    Move attempted = {SELECTED, coordinate};
-    GameState newState = makeMove(current, attempted, moves);
+    // play the selected piece's move to the clicked square, if it has one;
+    // a pawn reaching the last rank becomes a queen
+    GameState newState = current;
+    if (inBounds(coordinate.x, coordinate.y)) {
+      const int to = squareOf(coordinate.x, coordinate.y);
+      for (const Move &move : moves) {
+        if (move.to() == to &&
+            (!move.isPromotion() || move.flag() == MOVE_PROMOTE_QUEEN)) {
+          newState = makeMove(current, move, moves);
+          break;
+        }
+      }
+    }
 
-    bool same = std::equal(&newState.board[0][0], &newState.board[0][0] + 64,
-                           &current.board[0][0]);
+    bool same = std::equal(newState.board, newState.board + 64,
+                           current.board);
 
     if (!same) {
       mode = DEACTIVED;
@@ -113,7 +98,7 @@ sf::Vector2i selectPiece(sf::Vector2i localPosition, GameState &current) {
       return coordinate;
     }
     if (inBounds(coordinate.x, coordinate.y)) {
-      int clicked = BOARD[coordinate.y][coordinate.x];
+      int clicked = current.board[squareOf(coordinate.x, coordinate.y)];
       if (clicked != EMPTY && colorOf(clicked) == current.sideToMove) {
         SELECTED = coordinate;
         return coordinate;
@@ -121,152 +106,397 @@ sf::Vector2i selectPiece(sf::Vector2i localPosition, GameState &current) {
     }
     mode = DEACTIVED;
     SELECTED = {-1, -1};
-    return sf::Vector2i{-1, -1};
+    return Coord{-1, -1};
   }
-  return sf::Vector2i{-1, -1};
+  return Coord{-1, -1};
 };
 
-void drawBoard(sf::RenderWindow *win, int (&PLACEHOLDER)[8][8]) {
+// The renderer draws everything as triangles in three vertex arrays: the
+// squares (built once), the overlays for the current frame, and the pieces,
+// textured from the sprite atlas. That is three draw calls a frame, and
+// frames are only drawn when something changes.
+
+// Appends a rectangle as two triangles, optionally textured from `texPos`.
+void addQuad(sf::VertexArray &vertices, sf::Vector2f pos, sf::Vector2f size,
+             sf::Color col, sf::Vector2f texPos = {},
+             sf::Vector2f texSize = {}) {
+  static const sf::Vector2f corners[4] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+  for (int i : {0, 1, 2, 0, 2, 3}) {
+    const sf::Vector2f c = corners[i];
+    vertices.append({{pos.x + c.x * size.x, pos.y + c.y * size.y},
+                     col,
+                     {texPos.x + c.x * texSize.x, texPos.y + c.y * texSize.y}});
+  }
+}
+
+void addTile(sf::VertexArray &vertices, sf::Color col, int x, int y) {
+  addQuad(vertices, {x * 150.0f, y * 150.0f}, {150.0f, 150.0f}, col);
+}
+
+// A filled circle as a fan of triangles (as many as sf::CircleShape uses).
+void addCircle(sf::VertexArray &vertices, sf::Color col, sf::Vector2f center,
+               float radius) {
+  const int segments = 30;
+  for (int i = 0; i < segments; ++i) {
+    const float a0 = 2 * 3.14159265f * i / segments;
+    const float a1 = 2 * 3.14159265f * (i + 1) / segments;
+    const sf::Vector2f p0 = {center.x + radius * std::cos(a0),
+                             center.y + radius * std::sin(a0)};
+    const sf::Vector2f p1 = {center.x + radius * std::cos(a1),
+                             center.y + radius * std::sin(a1)};
+    vertices.append({center, col, {}});
+    vertices.append({p0, col, {}});
+    vertices.append({p1, col, {}});
+  }
+}
+
+sf::VertexArray buildBoard() {
+  sf::VertexArray vertices(sf::PrimitiveType::Triangles);
   for (int i = 0; i < 8; ++i) {
     for (int j = 0; j < 8; ++j) {
       if (((i + j) % 2) == 0) {
-        if (SELECTED.x == j && SELECTED.y == i) {
-          drawTile(win, sf::Color(130, 70, 190), {j * 150.0f, i * 150.0f});
-        } else {
-          drawTile(win, sf::Color(45, 30, 60), {j * 150.0f, i * 150.0f});
-        }
+        addTile(vertices, sf::Color(45, 30, 60), j, i);
       } else {
-        if (SELECTED.x == j && SELECTED.y == i) {
-          drawTile(win, sf::Color(225, 200, 255), {j * 150.0f, i * 150.0f});
-
-        } else {
-          drawTile(win, sf::Color(140, 120, 150), {j * 150.0f, i * 150.0f});
-        }
+        addTile(vertices, sf::Color(140, 120, 150), j, i);
       }
     }
   }
+  return vertices;
+}
+
+// Selected square, move hints, and while the AI is thinking a tint on the
+// from and to squares of the best move it has found so far.
+void buildOverlay(sf::VertexArray &vertices, const RenderFrame &frame) {
+  vertices.clear();
+  const Coord sel = frame.selected;
+  if (inBounds(sel.x, sel.y)) {
+    if (((sel.x + sel.y) % 2) == 0) {
+      addTile(vertices, sf::Color(130, 70, 190), sel.x, sel.y);
+    } else {
+      addTile(vertices, sf::Color(225, 200, 255), sel.x, sel.y);
+    }
+  }
   for (int i = 0; i < 8; ++i) {
     for (int j = 0; j < 8; ++j) {
-      if (PLACEHOLDER[j][i] == 1) {
-        drawPlaceholder(win, sf::Color::Cyan,
-                        {(i * 150.0f) + 55.0f, (j * 150.0f) + 55.0f});
+      if (frame.placeholder[j][i] == 1) {
+        addCircle(vertices, sf::Color::Cyan,
+                  {(i * 150.0f) + 75.0f, (j * 150.0f) + 75.0f}, 20.0f);
       }
     }
   }
+  if (frame.thinking) {
+    const Move &best = frame.bestMove;
+    addTile(vertices, sf::Color(255, 165, 0, 110), fileOf(best.from()),
+            rowOf(best.from()));
+    addTile(vertices, sf::Color(255, 165, 0, 110), fileOf(best.to()),
+            rowOf(best.to()));
+  }
 }
 
-void drawPiece(sf::RenderWindow *win, int piece, sf::Vector2f coordinate,
-               TextureManager &texManager) {
-  if (piece != 0) {
-    sf::Texture *texture = texManager.getTexture(piece);
-    texture->setSmooth(true);
-    sf::Sprite sprite(*texture);
-    sprite.setPosition(coordinate * 150.0f);
-    sprite.setScale({1.2f, 1.2f});
-
-    win->draw(sprite);
+void buildPieces(sf::VertexArray &vertices, const int8_t (&board)[64],
+                 const TextureManager &texManager) {
+  vertices.clear();
+  const float cell = texManager.getCellSize();
+  for (int sq = 0; sq < 64; ++sq) {
+    const int piece = board[sq];
+    if (piece != 0) {
+      addQuad(vertices, {fileOf(sq) * 150.0f, rowOf(sq) * 150.0f},
+              {cell * 1.2f, cell * 1.2f}, sf::Color::White,
+              texManager.getCellPosition(piece), {cell, cell});
+    }
   }
 }
 
-void drawPieces(int board[][8], sf::RenderWindow *win,
-                TextureManager &texManager) {
-  for (int i = 0; i < 8; ++i) {
-    for (int j = 0; j < 8; ++j) {
-      drawPiece(win, board[j][i], {(float)i, (float)j}, texManager);
+// Wakes the render thread when there is a new frame to draw, or when it is
+// time to stop; it sleeps the rest of the time.
+struct FrameSignal {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool pending = false;
+
+  void notify() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending = true;
     }
+    cv.notify_one();
   }
-}
 
-void renderingThread(sf::RenderWindow *win, GameState *state,
-                     int (&PLACEHOLDER)[8][8]) {
+  // Returns false once the renderer should exit.
+  bool wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this] { return pending; });
+    pending = false;
+    return running;
+  }
+};
+
+void renderingThread(sf::RenderWindow *win, TripleBuffer<RenderFrame> *frames,
+                     FrameSignal *signal) {
   bool set = win->setActive(true);
 
   TextureManager texManager;
-  while (win->isOpen()) {
-    // draw n stuff
-    while (running) {
-      win->clear();
-      drawBoard(win, PLACEHOLDER);
-      drawPieces(state->board, win, texManager);
-      win->display();
-    }
-  };
+  const sf::VertexArray board = buildBoard();
+  sf::VertexArray overlay(sf::PrimitiveType::Triangles);
+  sf::VertexArray pieces(sf::PrimitiveType::Triangles);
+
+  // draw n stuff, only when the game loop has published a new frame
+  while (signal->wait()) {
+    frames->update();
+    const RenderFrame &frame = frames->front();
+    buildOverlay(overlay, frame);
+    buildPieces(pieces, frame.board, texManager);
+
+    win->clear();
+    win->draw(board);
+    win->draw(overlay);
+    win->draw(pieces, &texManager.getAtlas());
+    win->display();
+  }
+  set = win->setActive(false);
 };
 
-int main() {
+bool sameFrame(const RenderFrame &a, const RenderFrame &b) {
+  return std::equal(a.board, a.board + 64, b.board) &&
+         std::equal(&a.placeholder[0][0], &a.placeholder[0][0] + 64,
+                    &b.placeholder[0][0]) &&
+         a.selected == b.selected && a.thinking == b.thinking &&
+         (!a.thinking || a.bestMove == b.bestMove);
+}
+
+// Copies what the renderer needs out of the game loop's state and, if it
+// differs from the last frame (or `force` is set, e.g. after a resize), hands
+// it over and wakes the renderer.
+void publishFrame(TripleBuffer<RenderFrame> &frames, FrameSignal &signal,
+                  RenderFrame &last, const GameState &game,
+                  const int (&placeholder)[8][8], const AsyncSearch &search,
+                  bool force = false) {
+  RenderFrame frame;
+  std::copy(game.board, game.board + 64, frame.board);
+  std::copy(&placeholder[0][0], &placeholder[0][0] + 64,
+            &frame.placeholder[0][0]);
+  frame.selected = SELECTED;
+
+  const SearchProgress progress = search.progress();
+  frame.thinking = progress.pvLength > 0;
+  if (frame.thinking)
+    frame.bestMove = progress.pv[0];
+
+  if (!force && sameFrame(frame, last))
+    return;
+  last = frame;
+  frames.back() = frame;
+  frames.publish();
+  signal.notify();
+}
+
+// The position to start from: the standard one, or --fen "<fen>".
+GameState startPosition(int argc, char *argv[]) {
+  GameState game;
+  parseFEN(START_FEN, game);
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::string(argv[i]) == "--fen" && !parseFEN(argv[i + 1], game))
+      std::cerr << "Invalid FEN " << argv[i + 1] << std::endl;
+  }
+  return game;
+}
+
+// Search budget for the AI move. Override on the command line with
+// --movetime <ms>, --nodes <n>, --depth <plies> and --threads <n>. --book
+// <file.bin> opens a Polyglot opening book, played from before searching;
+// --syzygy <dir> loads endgame tablebases (directories separated by ':');
+// --nnue <file.nnue> evaluates with a network instead of the handcrafted
+// evaluation.
+SearchLimits parseLimits(int argc, char *argv[]) {
+  SearchLimits limits;
+  limits.moveTimeMs = 2000;
+  limits.threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string flag = argv[i];
+    long long value;
+    if (flag == "--movetime" || flag == "--nodes" || flag == "--depth" ||
+        flag == "--threads") {
+      const long long max = flag == "--movetime" || flag == "--nodes"
+                                ? LLONG_MAX
+                                : INT_MAX;
+      if (!parseCount(argv[i + 1], max, value))
+        std::cerr << "Bad value for " << flag << std::endl;
+      else if (flag == "--movetime")
+        limits.moveTimeMs = value;
+      else if (flag == "--nodes")
+        limits.nodes = value;
+      else if (flag == "--depth")
+        limits.depth = int(value);
+      else
+        limits.threads = int(value);
+    } else if (flag == "--book") {
+      if (!BOOK.open(argv[i + 1]))
+        std::cerr << "Cannot open book " << argv[i + 1] << std::endl;
+    } else if (flag == "--syzygy") {
+      if (initTablebases(argv[i + 1]) == 0)
+        std::cerr << "No tablebases in " << argv[i + 1] << std::endl;
+    } else if (flag == "--nnue") {
+      if (!NNUE.load(argv[i + 1]))
+        std::cerr << "Cannot load network " << argv[i + 1] << std::endl;
+    } else if (flag != "--fen")
+      std::cerr << "Unknown option " << flag << std::endl;
+  }
+  return limits;
+}
+
+// Window title while the AI is thinking: depth, score and expected line of
+// the last finished iteration.
+std::string searchTitle(const SearchProgress &progress) {
+  std::string title = "Chess - thinking";
+  if (progress.depth == 0)
+    return title + "...";
+  title += ": depth " + std::to_string(progress.depth) + ", score " +
+           std::to_string(progress.score) + ",";
+  for (int i = 0; i < progress.pvLength; ++i)
+    title += " " + moveToString(progress.pv[i]);
+  return title;
+}
+
+void printSearchResult(const evaluatedMove &bestMove,
+                       const SearchStats &stats) {
+  std::cout << "Best Move for Black: " << moveToString(bestMove.move)
+            << std::endl;
+  std::cout << "Depth " << stats.depth << ", score " << bestMove.score
+            << std::endl;
+  std::cout << "Nodes searched: " << stats.nodes
+            << " (leaves: " << stats.leafNodes
+            << ", quiescence: " << stats.quiescenceNodes
+            << ", cutoffs: " << stats.cutoffs << ", "
+            << stats.firstMoveCutoffRate() << "% on the first move) in "
+            << stats.elapsedMs << " ms, " << stats.nodesPerSecond()
+            << " nodes/sec" << std::endl;
+  std::cout << "Hash: " << stats.ttHits << "/" << stats.ttProbes << " hits ("
+            << stats.ttHitRate() << "%), " << stats.hashfull / 10.0 << "% full"
+            << std::endl;
+  if (stats.tbHits)
+    std::cout << "Tablebase hits: " << stats.tbHits << std::endl;
+  dumpTrace(std::cout);
+}
+
+int main(int argc, char *argv[]) {
+  const SearchLimits limits = parseLimits(argc, argv);
+
   sf::RenderWindow window(sf::VideoMode({1200, 1200}), "Chess");
   bool set = window.setActive(false);
   window.setPosition({0, 0});
   window.setFramerateLimit(60);
-  GameState game;
-
-  int board[8][8] = {
-      {B_ROOK, B_KNIGHT, B_BISHOP, B_QUEEN, B_KING, B_BISHOP, B_KNIGHT,
-       B_ROOK}, // Row 0 (Black Back Rank)
-      {B_PAWN, B_PAWN, B_PAWN, B_PAWN, B_PAWN, B_PAWN, B_PAWN,
-       B_PAWN}, // Row 1 (Black Pawns)
-      {EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY}, // Row 2
-      {EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY}, // Row 3
-      {EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY}, // Row 4
-      {EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY}, // Row 5
-      {W_PAWN, W_PAWN, W_PAWN, W_PAWN, W_PAWN, W_PAWN, W_PAWN,
-       W_PAWN}, // Row 6 (White Pawns)
-      {W_ROOK, W_KNIGHT, W_BISHOP, W_QUEEN, W_KING, W_BISHOP, W_KNIGHT,
-       W_ROOK} // Row 7 (White Back Rank)
-  };
-
-  std::copy(&board[0][0], &board[0][0] + 64,
-            &game.board[0][0]); // assign start gamestate board using memory
-                                // copy (what a wonderful programming language
-                                // this is)
-  game.sideToMove = WHITE;
-  game.kingPos[WHITE] = {4, 7};
-  game.kingPos[BLACK] = {4, 0};
+  GameState game = startPosition(argc, argv);
 
   int placeholder[8][8] = {{0}};
 
-  std::thread thread(&renderingThread, &window, &game, std::ref(placeholder));
+  // The AI searches on a worker thread; this loop keeps handling input and
+  // picks the move up when it is ready. history holds the position before
+  // every move played, for takeback.
+  AsyncSearch search;
+  std::vector<GameState> history;
+  int shownDepth = -1;
+  bool redraw = false; // the window needs drawing even if nothing changed
+
+  // Only this thread touches game and placeholder; the renderer draws the
+  // frames published from them.
+  TripleBuffer<RenderFrame> frames;
+  FrameSignal signal;
+  RenderFrame lastFrame;
+  publishFrame(frames, signal, lastFrame, game, placeholder, search, true);
+  std::thread thread(&renderingThread, &window, &frames, &signal);
 
   while (window.isOpen()) {
-    // game loop
-    while (const std::optional event = window.pollEvent()) {
+    // game loop. Wait for input, but wake at least once a frame (60 Hz) to
+    // check on the search.
+    std::optional<sf::Event> event = window.waitEvent(sf::milliseconds(16));
+    for (; event; event = window.pollEvent()) {
       if (event->is<sf::Event::Closed>()) {
-        window.close();
+        // stop the renderer before the window goes away under it
+        search.cancel();
         running = false;
+        signal.notify();
+        thread.join();
+        window.close();
+        break;
       }
+      if (event->is<sf::Event::Resized>())
+        redraw = true;
       if (const auto *mouseEvent =
               event->getIf<sf::Event::MouseButtonPressed>()) {
-        if (mouseEvent->button == sf::Mouse::Button::Left) {
+        // the board is the AI's while it is thinking
+        if (mouseEvent->button == sf::Mouse::Button::Left && !search.busy()) {
           std::fill(&placeholder[0][0],
                     &placeholder[0][0] + sizeof(placeholder) / sizeof(int), 0);
 
           sf::Vector2i mousePos(mouseEvent->position.x, mouseEvent->position.y);
-          sf::Vector2i coordinate = selectPiece(mousePos, game);
-          if (colorOf(game.board[coordinate.y][coordinate.x]) ==
-              game.sideToMove) {
-            moves = calculatePossibleMoves(
-                game.board[coordinate.y][coordinate.x], coordinate, game);
+          GameState before = game;
+          Coord coordinate = selectPiece(mousePos, game);
+          if (game.key != before.key)
+            history.push_back(before);
+          const int clicked =
+              inBounds(coordinate.x, coordinate.y)
+                  ? game.board[squareOf(coordinate.x, coordinate.y)]
+                  : int(EMPTY);
+          if (colorOf(clicked) == game.sideToMove) {
+            moves = calculatePossibleMoves(clicked, coordinate, game);
 
             for (Move move : moves) {
-              placeholder[move.to.y][move.to.x] = 1;
+              placeholder[rowOf(move.to())][fileOf(move.to())] = 1;
             }
           }
         }
       }
       if (const auto *keyboardEvent = event->getIf<sf::Event::KeyPressed>()) {
         if (keyboardEvent->code == sf::Keyboard::Key::Backslash) {
-          if (game.sideToMove == BLACK) {
+          Move bookMove;
+          if (game.sideToMove == BLACK && !search.busy() &&
+              BOOK.probe(game, bookMove)) {
+            std::cout << "Book move for Black: " << moveToString(bookMove)
+                      << std::endl;
+            history.push_back(game);
+            game = makeMove(game, bookMove);
+          } else if (game.sideToMove == BLACK && !search.busy()) {
             // we run minimax for black
-            evaluatedMove bestMove = Minimax(game, BLACK);
-            std::cout << "Best Move for Black: " << bestMove.move.from.y << ", "
-                      << bestMove.move.from.x << " -> " << bestMove.move.to.y
-                      << ", " << bestMove.move.to.x << std::endl;
-            game = makeMove(game, bestMove.move);
+            search.start(game, BLACK, limits);
+          }
+        }
+        if (keyboardEvent->code == sf::Keyboard::Key::F) {
+          // print the position, e.g. to analyse it with ./analyze
+          std::cout << toFEN(game) << std::endl;
+        }
+        if (keyboardEvent->code == sf::Keyboard::Key::Backspace) {
+          // take back the last move, abandoning the AI's search if it is
+          // thinking about a reply to it
+          search.cancel();
+          if (!history.empty()) {
+            game = history.back();
+            history.pop_back();
+            mode = DEACTIVED;
+            SELECTED = {-1, -1};
+            std::fill(&placeholder[0][0],
+                      &placeholder[0][0] + sizeof(placeholder) / sizeof(int),
+                      0);
           }
         }
       }
     }
-  };
 
-  thread.join();
+    evaluatedMove bestMove;
+    SearchStats stats;
+    if (search.poll(bestMove, stats)) {
+      printSearchResult(bestMove, stats);
+      history.push_back(game);
+      game = makeMove(game, bestMove.move);
+    }
+
+    const int depth = search.busy() ? search.progress().depth : -1;
+    if (depth != shownDepth && window.isOpen()) {
+      window.setTitle(search.busy() ? searchTitle(search.progress())
+                                    : "Chess");
+      shownDepth = depth;
+    }
+
+    publishFrame(frames, signal, lastFrame, game, placeholder, search, redraw);
+    redraw = false;
+  };
 }
@@ -0,0 +1,94 @@
+// Writes a Polyglot opening book from a file of opening lines, one per line,
+// each a sequence of moves in coordinate notation from the start position:
+//
+//   ./makebook <lines.txt> <book.bin>
+//
+// e.g. `e2e4 e7e5 g1f3 b8c6 f1b5`. Blank lines and lines starting with #
+// are skipped. Every position along a line gets that line's next move, and a
+// move's weight is the number of lines playing it there, so the engine
+// follows the popular moves more often.
+
+#include "Moves.h"
+#include "book.h"
+#include "fen.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "usage: " << argv[0] << " <lines.txt> <book.bin>"
+              << std::endl;
+    return 1;
+  }
+  std::ifstream in(argv[1]);
+  if (!in) {
+    std::cerr << "Cannot read " << argv[1] << std::endl;
+    return 1;
+  }
+
+  // (key, move) -> number of lines
+  std::map<std::pair<uint64_t, uint16_t>, int> counts;
+  std::string line;
+  int lineNumber = 0, lines = 0;
+  while (std::getline(in, line)) {
+    ++lineNumber;
+    std::istringstream moves(line);
+    std::string name;
+    if (!(moves >> name) || name[0] == '#')
+      continue;
+    ++lines;
+
+    GameState state;
+    parseFEN(START_FEN, state);
+    do {
+      Move move;
+      if (!parseMove(name, state, move)) {
+        std::cerr << "Line " << lineNumber << ": illegal move " << name
+                  << ", ignoring the rest of the line" << std::endl;
+        break;
+      }
+      ++counts[{polyglotKey(state), polyglotMove(move)}];
+      state = makeMove(state, move);
+    } while (moves >> name);
+  }
+
+  // sorted by key, and by weight within a key as Polyglot books are
+  std::vector<std::pair<std::pair<uint64_t, uint16_t>, int>> entries(
+      counts.begin(), counts.end());
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const auto &a, const auto &b) {
+                     if (a.first.first != b.first.first)
+                       return a.first.first < b.first.first;
+                     return a.second > b.second;
+                   });
+
+  std::ofstream out(argv[2], std::ios::binary);
+  for (const auto &entry : entries) {
+    const uint64_t key = entry.first.first;
+    const uint16_t move = entry.first.second;
+    const int weight = std::min(entry.second, 0xFFFF);
+    unsigned char bytes[16] = {}; // the learn field stays 0
+    for (int i = 0; i < 8; ++i)
+      bytes[i] = (unsigned char)(key >> (56 - 8 * i));
+    bytes[8] = (unsigned char)(move >> 8);
+    bytes[9] = (unsigned char)move;
+    bytes[10] = (unsigned char)(weight >> 8);
+    bytes[11] = (unsigned char)weight;
+    out.write(reinterpret_cast<const char *>(bytes), sizeof(bytes));
+  }
+  if (!out) {
+    std::cerr << "Cannot write " << argv[2] << std::endl;
+    return 1;
+  }
+
+  std::cout << "Wrote " << entries.size() << " entries from " << lines
+            << " lines to " << argv[2] << std::endl;
+  return 0;
+}
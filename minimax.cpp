@@ -1,204 +1,556 @@
+#include "minimax.h"
 #include "Moves.h"
-#include "TextureManager.h"
-#include "simulateMoves.h"
+#include "pieces.h"
+#include "evaluate.h"
+#include "movepick.h"
+#include "nnue.h"
+#include "tablebase.h"
+#include "transposition.h"
+#include "zobrist.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <thread>
 
-// Array for values of pieces
-// 0: Empty
-// 1-6:  W_PAWN, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING
-// 7-12: B_PAWN, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING
-
-enum colors { WHITE = 0, BLACK = 1 };
-
-static const int PIECE_VALUES[13] = {
-    0,     // EMPTY
-    100,   // W_PAWN
-    320,   // W_KNIGHT
-    330,   // W_BISHOP
-    500,   // W_ROOK
-    900,   // W_QUEEN
-    20000, // W_KING (Arbitrarily high so the engine never sacrifices it)
-    100,   // B_PAWN
-    320,   // B_KNIGHT
-    330,   // B_BISHOP
-    500,   // B_ROOK
-    900,   // B_QUEEN
-    20000  // B_KING
-};
+// Minimax algorithm, recursive. Written as negamax: every score is from the
+// point of view of the side to move, so one routine serves both colours and
+// the alpha-beta window just flips sign at each ply.
+const int INFINITE_SCORE = 10000000;
+
+// State shared by every thread working on one search.
+struct SharedSearch {
+  explicit SharedSearch(const SearchLimits &limits) : limits(limits) {}
 
-// --------------------------------------------------------------------------
-// PIECE-SQUARE TABLES (White's Perspective)
-// --------------------------------------------------------------------------
-// These are flat arrays of 64 integers.
-// Access them using: table[y * 8 + x]
-
-// PAWNS: Encourage moving forward and controlling the center (d4/e4).
-static const int mvv_luv[64] = {
-    0,   0,   0,   0,
-    0,   0,   0,   0, // Rank 8 (Promoted - usually irrelevant here)
-    50,  50,  50,  50,
-    50,  50,  50,  50, // Rank 7 (Almost promoted!)
-    10,  10,  20,  30,
-    30,  20,  10,  10, // Rank 6
-    5,   5,   10,  25,
-    25,  10,  5,   5, // Rank 5
-    0,   0,   0,   20,
-    20,  0,   0,   0, // Rank 4
-    5,   -5,  -10, 0,
-    0,   -10, -5,  5, // Rank 3
-    5,   10,  10,  -20,
-    -20, 10,  10,  5, // Rank 2 (Don't move f/g/h pawns too early)
-    0,   0,   0,   0,
-    0,   0,   0,   0 // Rank 1 (Base)
+  const SearchLimits &limits;
+  std::chrono::steady_clock::time_point start;
+  std::atomic<bool> stop{false};
+  std::atomic<unsigned long long> nodes{0}; // summed over threads, lagging
+  std::atomic<unsigned long long> tbHits{0}; // likewise
 };
 
-// KNIGHTS: Strong in the center, terrible at the edges/corners.
-static const int knight_pst[64] = {
-    -50, -40, -30, -30, -30, -30, -40, -50, -40, -20, 0,   0,   0,
-    0,   -20, -40, -30, 0,   10,  15,  15,  10,  0,   -30, -30, 5,
-    15,  20,  20,  15,  5,   -30, -30, 0,   15,  20,  20,  15,  0,
-    -30, -30, 5,   10,  15,  15,  10,  5,   -30, -40, -20, 0,   5,
-    5,   0,   -20, -40, -50, -40, -30, -30, -30, -30, -40, -50};
-
-// BISHOPS: Good on long diagonals, better in center than corners.
-static const int bishop_pst[64] = {
-    -20, -10, -10, -10, -10, -10, -10, -20, -10, 0,   0,   0,   0,
-    0,   0,   -10, -10, 0,   5,   10,  10,  5,   0,   -10, -10, 5,
-    5,   10,  10,  5,   5,   -10, -10, 0,   10,  10,  10,  10,  0,
-    -10, -10, 10,  10,  10,  10,  10,  10,  -10, -10, 5,   0,   0,
-    0,   0,   5,   -10, -20, -10, -10, -10, -10, -10, -10, -20};
-
-// ROOKS: Bonus for 7th rank (attacking enemy pawns) and centering.
-static const int rook_pst[64] = {
-    0, 0, 0, 0, 0, 0, 0, 0, 5, 10, 10, 10, 10, 10, 10, 5, // 7th Rank (Pig
-                                                          // on the 7th)
-    -5, 0, 0, 0, 0, 0, 0, -5, -5, 0, 0, 0, 0, 0, 0, -5, -5, 0, 0, 0, 0, 0, 0,
-    -5, -5, 0, 0, 0, 0, 0, 0, -5, -5, 0, 0, 0, 0, 0, 0, -5, 0, 0, 0, 5, 5, 0, 0,
-    0 // Castling squares
-      // slightly better
+// What a thread has learned about move order in its own tree: killer moves
+// per ply, and a history score per piece and destination square that grows
+// each time such a quiet move causes a cutoff.
+struct OrderingTables {
+  Move killers[MAX_PLY][2];
+  int history[13][64];
 };
 
-// QUEENS: Generally kept simple. Avoid corners, stay somewhat central.
-static const int queen_pst[64] = {
-    -20, -10, -10, -5, -5, -10, -10, -20, -10, 0,   0,   0,  0,  0,   0,   -10,
-    -10, 0,   5,   5,  5,  5,   0,   -10, -5,  0,   5,   5,  5,  5,   0,   -5,
-    0,   0,   5,   5,  5,  5,   0,   -5,  -10, 5,   5,   5,  5,  5,   0,   -10,
-    -10, 0,   5,   0,  0,  0,   0,   -10, -20, -10, -10, -5, -5, -10, -10, -20};
-
-// KINGS (MIDDLE GAME): Highly penalized for being in the center or open files.
-// Encourages castling into the corners (g1/b1).
-static const int king_pst[64] = {
-    -30, -40, -40, -50, -50, -40, -40, -30, -30, -40, -40, -50, -50, -40, -40,
-    -30, -30, -40, -40, -50, -50, -40, -40, -30, -30, -40, -40, -50, -50, -40,
-    -40, -30, -20, -30, -30, -40, -40, -30, -30, -20, -10, -20, -20, -20, -20,
-    -20, -20, -10, 20,  20,  0,   0,   0,   0,   20,  20, // Pawn shield rank
-    20,  30,  10,  0,   0,   10,  30,  20 // Back rank (Corners are safest)
+// History scores are halved once one gets this large, so old cutoffs fade
+// and the scores can't overflow.
+const int HISTORY_MAX = 1 << 20;
+
+// One search thread's view: the shared state plus its own counters.
+struct SearchContext {
+  SharedSearch *shared = nullptr;
+  int threadId = 0; // 0 is the main thread, whose result is returned
+  OrderingTables *ordering = nullptr; // on the thread's own stack
+  // per ply, with a network loaded (see nnue.h); on the heap, as they are
+  // too large for a thread's stack
+  NNUEAccumulator *accumulators = nullptr;
+  SearchStats stats;
+  unsigned long long nodesReported = 0; // part of stats.nodes in shared.nodes
+  unsigned long long tbHitsReported = 0;
+  bool stopped = false; // budget ran out; unwind without trusting scores
 };
 
-int positionalScore(int piece, int x, int y) {
-  if (piece == EMPTY)
-    return 0;
+static long long elapsedMs(const SharedSearch &shared) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - shared.start)
+      .count();
+}
 
-  const int *table = nullptr;
-  if (piece == W_PAWN || piece == B_PAWN)
-    table = mvv_luv;
-  else if (piece == W_KNIGHT || piece == B_KNIGHT)
-    table = knight_pst;
-  else if (piece == W_BISHOP || piece == B_BISHOP)
-    table = bishop_pst;
-  else if (piece == W_ROOK || piece == B_ROOK)
-    table = rook_pst;
-  else if (piece == W_QUEEN || piece == B_QUEEN)
-    table = queen_pst;
-  else if (piece == W_KING || piece == B_KING)
-    table = king_pst;
-
-  if (!table)
-    return 0;
+// Called at every node. Every 1024 nodes the thread adds its count to the
+// shared total and checks the budgets and the other threads' stop flag;
+// doing that at every node would make the threads fight over one cache line.
+static bool shouldStop(SearchContext &ctx) {
+  if (ctx.stopped)
+    return true;
+  if ((ctx.stats.nodes & 1023) != 0)
+    return false;
 
-  if (colorOf(piece) == WHITE) {
-    return table[y * 8 + x];
-  } else {
-    return table[(7 - y) * 8 + x];
+  SharedSearch &shared = *ctx.shared;
+  const unsigned long long total =
+      shared.nodes.fetch_add(ctx.stats.nodes - ctx.nodesReported,
+                             std::memory_order_relaxed) +
+      (ctx.stats.nodes - ctx.nodesReported);
+  ctx.nodesReported = ctx.stats.nodes;
+  shared.tbHits.fetch_add(ctx.stats.tbHits - ctx.tbHitsReported,
+                          std::memory_order_relaxed);
+  ctx.tbHitsReported = ctx.stats.tbHits;
+
+  if ((shared.limits.nodes && total >= shared.limits.nodes) ||
+      (shared.limits.moveTimeMs &&
+       elapsedMs(shared) >= shared.limits.moveTimeMs) ||
+      (shared.limits.cancel &&
+       shared.limits.cancel->load(std::memory_order_relaxed)))
+    shared.stop.store(true, std::memory_order_relaxed);
+
+  ctx.stopped = shared.stop.load(std::memory_order_relaxed);
+  return ctx.stopped;
+}
+
+// Mate and tablebase scores count plies from the root, but a table entry can
+// be reached at any ply. Store them counted from the node itself and convert
+// back on probe.
+static int scoreToTT(int score, int ply) {
+  if (score >= TB_WIN_SCORE - MAX_PLY)
+    return score + ply;
+  if (score <= -TB_WIN_SCORE + MAX_PLY)
+    return score - ply;
+  return score;
+}
+
+static int scoreFromTT(int score, int ply) {
+  if (score >= TB_WIN_SCORE - MAX_PLY)
+    return score - ply;
+  if (score <= -TB_WIN_SCORE + MAX_PLY)
+    return score + ply;
+  return score;
+}
+
+// Score of a tablebase result `ply` plies from the root. Wins and losses the
+// fifty-move rule would draw only lean away from the draw.
+static int tablebaseScore(WDLScore wdl, int ply) {
+  switch (wdl) {
+  case WDL_WIN:
+    return TB_WIN_SCORE - ply;
+  case WDL_LOSS:
+    return -TB_WIN_SCORE + ply;
+  default:
+    return wdl; // -1, 0 or 1
   }
 }
 
-int evaluateScore(GameState state, int color) {
-  // Given a game state, return an integer value for the score of the game
-  int score = 0;
-  for (int y = 0; y < 8; ++y) {
-    for (int x = 0; x < 8; ++x) {
-      int piece = state.board[y][x];
-      if (colorOf(piece) == color) {
-        score += PIECE_VALUES[piece];
-        score += positionalScore(piece, x, y);
+// A quiet move refuted this node: remember it as a killer for this ply and
+// credit it in the history table, more for deeper (costlier) cutoffs.
+static void rewardQuietMove(SearchContext &ctx, int ply, int depth, int piece,
+                            const Move &move) {
+  Move *killers = ctx.ordering->killers[ply];
+  if (killers[0] != move) {
+    killers[1] = killers[0];
+    killers[0] = move;
+  }
 
-      } else {
-        score -= PIECE_VALUES[state.board[y][x]];
-        score -= positionalScore(piece, x, y);
-      }
+  int(&history)[13][64] = ctx.ordering->history;
+  int &entry = history[piece][move.to()];
+  entry += depth * depth;
+  if (entry >= HISTORY_MAX) {
+    for (auto &row : history)
+      for (int &h : row)
+        h /= 2;
+  }
+}
+
+// doMove from a node `ply` plies deep, noting for the network what changed.
+static void playMove(GameState &state, const Move &move, Undo &undo, int ply,
+                     SearchContext &ctx) {
+  doMove(state, move, undo);
+  if (ctx.accumulators)
+    recordMove(ctx.accumulators[ply + 1], state, undo);
+}
+
+// Score of a quiet position for the side to move: the network's if one is
+// loaded, otherwise the handcrafted evaluation.
+static int evaluateNode(const GameState &state, int ply, SearchContext &ctx) {
+  if (ctx.accumulators)
+    return NNUE.evaluate(state, ctx.accumulators, ply);
+  return evaluateScore(state, state.sideToMove);
+}
+
+// Moves the hash move, if it is in the list, to the front so it is searched
+// first; it is the move most likely to cause a cutoff.
+static void hashMoveFirst(MoveList &moves, const Move &hashMove) {
+  for (int i = 1; i < moves.size(); ++i) {
+    if (moves[i] == hashMove) {
+      std::swap(moves[0], moves[i]);
+      return;
     }
   }
-  return score;
 }
 
-// Minimax algorithm, recursive
-const int CAP = 5; // think no more than 5 moves ahead
-int counter = 0;
+// A capture has to be able to lift the score this far past alpha, beyond the
+// value of the piece it takes, to be worth searching in quiescence.
+const int DELTA_MARGIN = 200;
 
-evaluatedMove Minimax(GameState state, int side, Move lastMove, int depth) {
-  // base case
-  if (depth == CAP) {
-    return {lastMove, evaluateScore(state, side)};
+// Searches captures and queen promotions only until the position is quiet,
+// so the score at the end of a line never lands in the middle of an exchange
+// (the horizon effect). The side to move may "stand pat" on the static
+// evaluation instead of capturing, since it is never forced to. Captures that cannot raise the
+// score to alpha even after winning the piece (delta pruning), or that lose
+// material by static exchange, are skipped. In check there is no standing
+// pat: every evasion is searched and no moves means mate.
+static int quiescence(GameState &state, int ply, int alpha, int beta,
+                      SearchContext &ctx) {
+  if (shouldStop(ctx))
+    return 0;
+  SearchStats &stats = ctx.stats;
+  ++stats.nodes;
+  ++stats.quiescenceNodes;
+  // long runs of checks could otherwise go past the per-ply arrays
+  if (ply >= MAX_PLY)
+    return evaluateNode(state, ply, ctx);
+
+  const bool inCheck = isInCheck(state, state.sideToMove);
+  int best = -INFINITE_SCORE;
+  int standPat = 0;
+  if (!inCheck) {
+    ++stats.leafNodes;
+    standPat = evaluateNode(state, ply, ctx);
+    if (standPat >= beta || ply >= MAX_PLY - 1)
+      return standPat;
+    best = standPat;
+    alpha = std::max(alpha, standPat);
   }
-  evaluatedMove bestMove;
-  bestMove.move = {{-1, -1}, {-1, -1}};
-  if (side == BLACK)
-    bestMove.score = -999999;
-  else
-    bestMove.score = 999999;
-  // recursive case. keep growing tree until depth == 4
-  // first, get every possible move
-  std::vector<Move> moves;
-  for (int y = 0; y < 8; ++y) {
-    for (int x = 0; x < 8; ++x) {
-      int piece = state.board[y][x];
-      if (colorOf(piece) == side) {
-        std::vector<Move> pieceMoves =
-            calculatePossibleMoves(piece, {x, y}, state);
-        moves.insert(moves.end(), pieceMoves.begin(), pieceMoves.end());
+
+  MovePicker picker(state, inCheck);
+  int moveCount = 0;
+  Move move;
+  while (picker.next(move)) {
+    ++moveCount;
+    // promotions are always searched: neither test accounts for the new piece
+    if (!inCheck && !move.isPromotion()) {
+      const int victim = capturedPiece(state, move);
+      if (standPat + PIECE_VALUES[victim] + DELTA_MARGIN <= alpha)
+        continue;
+      if (staticExchange(state, move) < 0)
+        continue;
+    }
+
+    Undo undo;
+    playMove(state, move, undo, ply, ctx);
+    int score = -quiescence(state, ply + 1, -beta, -alpha, ctx);
+    undoMove(state, undo);
+    if (ctx.stopped)
+      return 0;
+
+    if (score > best) {
+      best = score;
+      if (score > alpha) {
+        alpha = score;
+        if (alpha >= beta)
+          break;
       }
     }
   }
-  if (moves.empty()) {
-    if (isInCheck(state, side)) {
-      // If White is mated, return a very low number (but slightly higher if it
-      // takes longer) If Black is mated, return a very high number (but
-      // slightly lower if it takes longer)
-      return {{{-1, -1}, {-1, -1}},
-              (side == WHITE) ? -1000000 - depth : 1000000 + depth};
-    } else {
-      return {{{-1, -1}, {-1, -1}}, 0};
+
+  if (inCheck && moveCount == 0)
+    return -MATE_SCORE + ply;
+  return best;
+}
+
+// Fail-soft alpha-beta: the returned score may lie outside [alpha, beta], in
+// which case it is a bound on the true value rather than the value itself.
+// Once the budget runs out every call returns 0 straight away; callers check
+// ctx.stopped before using a score.
+static int negamax(GameState &state, int depth, int ply, int alpha, int beta,
+                   SearchContext &ctx) {
+  if (depth == 0)
+    return quiescence(state, ply, alpha, beta, ctx);
+  if (shouldStop(ctx))
+    return 0;
+  SearchStats &stats = ctx.stats;
+  ++stats.nodes;
+
+  // A stored result at least as deep as this one can answer the node outright
+  // if its bound is tight enough for the window.
+  TTData entry;
+  ++stats.ttProbes;
+  const bool ttHit = TT.probe(state.key, entry);
+  if (ttHit) {
+    ++stats.ttHits;
+    if (entry.depth >= depth) {
+      int ttScore = scoreFromTT(entry.score, ply);
+      if (entry.bound == BOUND_EXACT ||
+          (entry.bound == BOUND_LOWER && ttScore >= beta) ||
+          (entry.bound == BOUND_UPPER && ttScore <= alpha))
+        return ttScore;
     }
   }
-  // Now moves is a list of all possible moves we can make in our current
-  // state.
-  int enemy = !side;
-  for (Move move : moves) {
-    evaluatedMove result =
-        Minimax(simulateMove(state, move), enemy, move, depth + 1);
-    if (side == BLACK) {
-      if (result.score > bestMove.score) {
-        bestMove.score = result.score;
-        bestMove.move = move;
-      }
-    } else {
-      if (result.score < bestMove.score) {
-        bestMove.score = result.score;
-        bestMove.move = move;
+
+  // With few pieces left the tablebases know the result exactly. It holds
+  // whatever the remaining depth, so it is stored as deep as can be.
+  if (tablebaseCanProbe(state, ctx.shared->limits.tbProbeLimit)) {
+    WDLScore wdl;
+    if (probeWDL(state, wdl)) {
+      ++stats.tbHits;
+      const int score = tablebaseScore(wdl, ply);
+      TT.store(state.key, MAX_DEPTH, BOUND_EXACT, scoreToTT(score, ply),
+               MOVE_NONE);
+      return score;
+    }
+  }
+
+  MovePicker picker(state, ttHit ? entry.move : MOVE_NONE,
+                    ctx.ordering->killers[ply], ctx.ordering->history);
+
+  const int alphaOrig = alpha;
+  int best = -INFINITE_SCORE;
+  Move bestMove = MOVE_NONE;
+  int moveCount = 0;
+  Move move;
+  while (picker.next(move)) {
+    ++moveCount;
+    const int piece = state.board[move.from()];
+    const bool quiet = !isTactical(state, move);
+
+    Undo undo;
+    playMove(state, move, undo, ply, ctx);
+    int score = -negamax(state, depth - 1, ply + 1, -beta, -alpha, ctx);
+    undoMove(state, undo);
+    if (ctx.stopped)
+      return 0;
+
+    if (score > best) {
+      best = score;
+      bestMove = move;
+      if (score > alpha) {
+        alpha = score;
+        if (alpha >= beta) {
+          ++stats.cutoffs;
+          ++stats.cutoffsAtDepth[depth];
+          if (moveCount == 1)
+            ++stats.firstMoveCutoffsAtDepth[depth];
+          if (quiet)
+            rewardQuietMove(ctx, ply, depth, piece, move);
+          break; // opponent will never allow this line
+        }
       }
     }
   }
 
+  if (moveCount == 0) {
+    // mated positions score worse the sooner they happen, so the winning side
+    // prefers the shortest mate and the losing side the longest defence
+    if (isInCheck(state, state.sideToMove))
+      return -MATE_SCORE + ply;
+    return 0; // stalemate
+  }
+
+  const int bound = best >= beta        ? BOUND_LOWER
+                    : best > alphaOrig ? BOUND_EXACT
+                                       : BOUND_UPPER;
+  TT.store(state.key, depth, bound, scoreToTT(best, ply),
+           bound == BOUND_UPPER ? MOVE_NONE : bestMove);
+  return best;
+}
+
+// One iteration at the root. `moves` is reordered so the best move found
+// comes first, which is where the next, deeper iteration starts.
+//
+// The root keeps a full window on its lower side only, so every move that
+// beats the current best comes back with an exact score. Ties keep the
+// earlier move, which is what a full-width search would pick as well.
+static evaluatedMove searchRoot(GameState &state, MoveList &moves, int depth,
+                                SearchContext &ctx) {
+  evaluatedMove bestMove;
+  bestMove.score = -INFINITE_SCORE;
+  int bestIndex = 0;
+
+  ++ctx.stats.nodes;
+  int alpha = -INFINITE_SCORE;
+  for (int i = 0; i < moves.size(); ++i) {
+    Undo undo;
+    playMove(state, moves[i], undo, 0, ctx);
+    int score = -negamax(state, depth - 1, 1, -INFINITE_SCORE, -alpha, ctx);
+    undoMove(state, undo);
+    if (ctx.stopped)
+      break;
+
+    if (score > bestMove.score) {
+      bestMove.score = score;
+      bestMove.move = moves[i];
+      bestIndex = i;
+      alpha = std::max(alpha, score);
+    }
+  }
+
+  if (!ctx.stopped) {
+    std::rotate(moves.begin(), moves.begin() + bestIndex,
+                moves.begin() + bestIndex + 1);
+    TT.store(state.key, depth, BOUND_EXACT, bestMove.score, bestMove.move);
+  }
+  return bestMove;
+}
+
+// Follows hash moves from the root to recover the line the search expects.
+// Entries along it may have been overwritten, so the line can come out
+// shorter than the search depth.
+static int collectPV(GameState state, Move move, Move *pv, int maxLength) {
+  int length = 0;
+  while (length < maxLength && isLegalMove(state, move)) {
+    pv[length++] = move;
+    Undo undo;
+    doMove(state, move, undo);
+    TTData entry;
+    if (!TT.probe(state.key, entry))
+      break;
+    move = entry.move;
+  }
+  return length;
+}
+
+static void reportProgress(const GameState &state,
+                           const evaluatedMove &result, int depth,
+                           SearchContext &ctx) {
+  const SharedSearch &shared = *ctx.shared;
+  SearchProgress progress;
+  progress.depth = depth;
+  progress.score = result.score;
+  progress.pvLength = collectPV(state, result.move, progress.pv, depth);
+  progress.nodes = shared.nodes.load(std::memory_order_relaxed) +
+                   (ctx.stats.nodes - ctx.nodesReported);
+  progress.tbHits = shared.tbHits.load(std::memory_order_relaxed) +
+                    (ctx.stats.tbHits - ctx.tbHitsReported);
+  progress.elapsedMs = elapsedMs(shared);
+  shared.limits.onProgress(progress);
+}
+
+// Runs iterative deepening on this thread's own copy of the position.
+static evaluatedMove iterativeDeepening(GameState state, SearchContext &ctx) {
+  const SearchLimits &limits = ctx.shared->limits;
+  const bool mainThread = ctx.threadId == 0;
+
+  OrderingTables ordering = {};
+  ctx.ordering = &ordering;
+  std::unique_ptr<NNUEAccumulator[]> accumulators;
+  if (NNUE.isLoaded()) {
+    accumulators.reset(new NNUEAccumulator[MAX_PLY + 1]);
+    resetAccumulator(accumulators[0]);
+    ctx.accumulators = accumulators.get();
+  }
+
+  evaluatedMove bestMove;
+  MoveList moves;
+  generateAllMoves(state, moves);
+  if (moves.empty()) {
+    bestMove.score = isInCheck(state, state.sideToMove) ? -MATE_SCORE : 0;
+    return bestMove;
+  }
+  // if the budget is gone before depth 1 finishes, any legal move beats none
+  bestMove.move = moves[0];
+  bestMove.score = 0;
+
+  TTData entry;
+  if (TT.probe(state.key, entry))
+    hashMoveFirst(moves, entry.move);
+
+  // Search depth 1, 2, 3, ... until the depth limit or the budget is reached,
+  // keeping the result of the last depth that finished. Each iteration is
+  // cheap next to the one after it, and it seeds the transposition table and
+  // root move order for that next one.
+  //
+  // Helper threads (Lazy SMP) run the same loop on the shared table. Odd
+  // helpers start a ply deeper so the threads are not all in lockstep on the
+  // same depth; the entries they store let the main thread cut off earlier.
+  const int maxDepth = limits.depth > 0 ? std::min(limits.depth, MAX_DEPTH)
+                                        : MAX_DEPTH;
+  for (int depth = 1 + (ctx.threadId & 1); depth <= maxDepth; ++depth) {
+    evaluatedMove result = searchRoot(state, moves, depth, ctx);
+    if (ctx.stopped)
+      break;
+    bestMove = result;
+    ctx.stats.depth = depth;
+
+    if (!mainThread)
+      continue; // helpers run until the main thread says stop
+    if (limits.onProgress)
+      reportProgress(state, result, depth, ctx);
+
+    // a forced mate will not get any better by looking deeper
+    if (std::abs(result.score) >= MATE_SCORE - MAX_PLY)
+      break;
+    // the next depth usually takes several times longer than this one, so
+    // don't start it if it could not finish in the time left
+    if (limits.moveTimeMs &&
+        elapsedMs(*ctx.shared) * 2 >= limits.moveTimeMs)
+      break;
+  }
+  return bestMove;
+}
+
+evaluatedMove Minimax(GameState state, int side, const SearchLimits &limits,
+                      SearchStats *stats) {
+  SharedSearch shared(limits);
+  shared.start = std::chrono::steady_clock::now();
+  if (state.sideToMove != side) {
+    state.sideToMove = side;
+    state.key ^= zobristBlackToMove;
+  }
+  if (limits.newGeneration)
+    TT.newSearch();
+
+  // In a tablebase position the tables pick the move: the one keeping the
+  // best result, fastest to the next capture or pawn move when winning.
+  Move tbMove;
+  WDLScore wdl;
+  if (tablebaseCanProbe(state, limits.tbProbeLimit) &&
+      probeRoot(state, tbMove, wdl)) {
+    evaluatedMove bestMove;
+    bestMove.move = tbMove;
+    bestMove.score = tablebaseScore(wdl, 0);
+    SearchStats total;
+    total.tbHits = 1;
+    total.depth = 1;
+    total.hashfull = TT.hashfull();
+    total.elapsedMs = elapsedMs(shared);
+    if (limits.onProgress) {
+      SearchProgress progress;
+      progress.depth = 1;
+      progress.score = bestMove.score;
+      progress.pv[0] = tbMove;
+      progress.pvLength = 1;
+      progress.tbHits = 1;
+      progress.elapsedMs = total.elapsedMs;
+      limits.onProgress(progress);
+    }
+    if (stats)
+      *stats = total;
+    return bestMove;
+  }
+
+  // contexts and thread handles live on the stack: with one thread the whole
+  // search makes no heap allocation (each extra thread costs one, inside
+  // std::thread)
+  const int threadCount = std::clamp(limits.threads, 1, MAX_THREADS);
+  SearchContext contexts[MAX_THREADS];
+  for (int i = 0; i < threadCount; ++i) {
+    contexts[i].shared = &shared;
+    contexts[i].threadId = i;
+  }
+
+  std::thread helpers[MAX_THREADS];
+  for (int i = 1; i < threadCount; ++i) {
+    helpers[i] = std::thread(
+        [&state, &contexts, i] { iterativeDeepening(state, contexts[i]); });
+  }
+  evaluatedMove bestMove = iterativeDeepening(state, contexts[0]);
+  shared.stop = true;
+  for (int i = 1; i < threadCount; ++i)
+    helpers[i].join();
+
+  SearchStats total;
+  for (int i = 0; i < threadCount; ++i) {
+    const SearchContext &ctx = contexts[i];
+    total.nodes += ctx.stats.nodes;
+    total.leafNodes += ctx.stats.leafNodes;
+    total.quiescenceNodes += ctx.stats.quiescenceNodes;
+    total.cutoffs += ctx.stats.cutoffs;
+    total.ttProbes += ctx.stats.ttProbes;
+    total.ttHits += ctx.stats.ttHits;
+    total.tbHits += ctx.stats.tbHits;
+    for (int d = 0; d <= MAX_DEPTH; ++d) {
+      total.cutoffsAtDepth[d] += ctx.stats.cutoffsAtDepth[d];
+      total.firstMoveCutoffsAtDepth[d] += ctx.stats.firstMoveCutoffsAtDepth[d];
+    }
+  }
+  total.depth = contexts[0].stats.depth;
+  total.hashfull = TT.hashfull();
+  total.elapsedMs = elapsedMs(shared);
+  if (stats)
+    *stats = total;
   return bestMove;
 }
@@ -1,10 +1,101 @@
 #pragma once
 #include "Moves.h"
+#include <atomic>
+#include <functional>
 
 struct evaluatedMove {
-  Move move;
+  Move move = MOVE_NONE;
   int score = 0;
 };
 
+// Deepest iteration the search will start.
+const int MAX_DEPTH = 64;
+// Most threads one search will use; larger requests are clamped to this.
+const int MAX_THREADS = 64;
+// Deepest ply the search reaches, quiescence included.
+const int MAX_PLY = 128;
+// Score of being mated at the root. Mate in n plies scores MATE_SCORE - n,
+// so anything within MAX_PLY of it is a forced mate.
+const int MATE_SCORE = 1000000;
+// Score of a tablebase win at the root, counted down per ply the same way.
+// Far above any evaluation and far below the mate scores, so a search that
+// finds an actual mate still prefers it.
+const int TB_WIN_SCORE = 20000;
+
+// What the search reports after each iteration that finishes.
+struct SearchProgress {
+  int depth = 0;
+  int score = 0;      // from the searching side's point of view
+  Move pv[MAX_DEPTH]; // line the search expects, best move first
+  int pvLength = 0;
+  unsigned long long nodes = 0; // all threads, as far as they have reported
+  unsigned long long tbHits = 0; // likewise, tablebase probes that answered
+  long long elapsedMs = 0;
+};
+
+// When a search has to stop, and how many threads to use. Zero means "no
+// limit" for the first three fields; with all of them zero the search only
+// stops at MAX_DEPTH.
+struct SearchLimits {
+  int depth = 0;                // deepest iteration to run
+  long long moveTimeMs = 0;     // wall-clock budget for the whole search
+  unsigned long long nodes = 0; // node budget for the whole search
+  int threads = 1;              // search threads sharing the hash table
+  // Positions with at most this many pieces are looked up in the endgame
+  // tablebases, when any are loaded (see tablebase.h).
+  int tbProbeLimit = 7;
+  // Start a new hash table generation, so older entries are replaced first.
+  // Searches running side by side on the table turn this off and start one
+  // generation for all of them, or each would age out the others' entries.
+  bool newGeneration = true;
+
+  // Set from another thread to stop early; the search then returns what the
+  // last finished iteration found, as it does when a budget runs out.
+  const std::atomic<bool> *cancel = nullptr;
+  // Called on the searching thread after every finished iteration.
+  std::function<void(const SearchProgress &)> onProgress;
+};
+
+// Counters filled in by a search so callers can see how much of the tree the
+// alpha-beta window cut away.
+struct SearchStats {
+  unsigned long long nodes = 0;     // positions visited, summed over threads
+  unsigned long long leafNodes = 0; // positions scored by evaluateScore
+  unsigned long long cutoffs = 0;   // beta cutoffs (remaining moves skipped)
+  long long elapsedMs = 0;          // wall-clock time of the whole search
+  int depth = 0;                    // last iteration that finished
+
+  // part of `nodes` spent in the capture-only search past the nominal depth
+  unsigned long long quiescenceNodes = 0;
+
+  unsigned long long ttProbes = 0; // transposition table lookups
+  unsigned long long ttHits = 0;   // lookups that found this position
+  int hashfull = 0;                // table occupancy after the search, permille
+
+  unsigned long long tbHits = 0; // positions the endgame tablebases answered
+
+  // Beta cutoffs by remaining depth, and how many of them the first move
+  // searched produced. The closer the two are, the better the move ordering.
+  unsigned long long cutoffsAtDepth[MAX_DEPTH + 1] = {};
+  unsigned long long firstMoveCutoffsAtDepth[MAX_DEPTH + 1] = {};
+
+  unsigned long long nodesPerSecond() const {
+    return nodes * 1000 / (elapsedMs > 0 ? elapsedMs : 1);
+  }
+  double ttHitRate() const {
+    return ttProbes ? 100.0 * ttHits / ttProbes : 0.0;
+  }
+  double firstMoveCutoffRate() const {
+    unsigned long long first = 0;
+    for (unsigned long long n : firstMoveCutoffsAtDepth)
+      first += n;
+    return cutoffs ? 100.0 * first / cutoffs : 0.0;
+  }
+};
+
+// Searches with iterative deepening until `limits` runs out and returns the
+// best move of the last iteration that finished, together with its score from
+// `side`'s point of view.
 evaluatedMove Minimax(GameState state, int side,
-                      Move lastMove = {{-1, -1}, {-1, -1}}, int depth = 0);
+                      const SearchLimits &limits = SearchLimits(),
+                      SearchStats *stats = nullptr);
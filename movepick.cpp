@@ -0,0 +1,125 @@
+#include "movepick.h"
+#include "pieces.h"
+#include "evaluate.h"
+
+#include <utility>
+
+MovePicker::MovePicker(const GameState &state, const Move &hashMove,
+                       const Move *killers, const int (*history)[64])
+    : state(state), hashMove(hashMove), history(history) {
+  this->killers[0] = killers[0];
+  this->killers[1] = killers[1];
+}
+
+MovePicker::MovePicker(const GameState &state, bool inCheck)
+    : state(state), history(nullptr), capturesOnly(!inCheck),
+      stage(STAGE_GEN_CAPTURES) {
+  // never legal, so the hash and killer stages pass straight through
+  hashMove = killers[0] = killers[1] = MOVE_NONE;
+}
+
+// Moves handed out by an earlier stage come up again when their stage's
+// list is generated; they are skipped there.
+bool MovePicker::alreadyTried(const Move &move) const {
+  return (hashValid && move == hashMove) ||
+         (killerValid[0] && move == killers[0]) ||
+         (killerValid[1] && move == killers[1]);
+}
+
+// Selection step: swaps the best-scoring remaining move to `current` and
+// returns it, skipping anything already tried.
+bool MovePicker::pickBest(Move &move) {
+  while (current < moves.size()) {
+    int best = current;
+    for (int i = current + 1; i < moves.size(); ++i) {
+      if (scores[i] > scores[best])
+        best = i;
+    }
+    std::swap(moves[current], moves[best]);
+    std::swap(scores[current], scores[best]);
+    move = moves[current++];
+    if (!alreadyTried(move))
+      return true;
+  }
+  return false;
+}
+
+bool MovePicker::next(Move &move) {
+  switch (stage) {
+  case STAGE_HASH:
+    stage = STAGE_GEN_CAPTURES;
+    if (isLegalMove(state, hashMove)) {
+      hashValid = true;
+      move = hashMove;
+      return true;
+    }
+    [[fallthrough]];
+
+  case STAGE_GEN_CAPTURES:
+    generateMoves(state, moves, GEN_CAPTURES);
+    for (int i = 0; i < moves.size(); ++i) {
+      const Move &m = moves[i];
+      const int attacker = state.board[m.from()];
+      // a promotion wins the difference between its piece and the pawn
+      int gain = PIECE_VALUES[capturedPiece(state, m)];
+      if (m.isPromotion())
+        gain += PIECE_VALUES[promotionPiece(m, state.sideToMove)] -
+                PIECE_VALUES[attacker];
+      // a legal king capture can't be answered by taking the king, so it
+      // counts as the cheapest attacker
+      const int attackerValue =
+          (attacker == W_KING || attacker == B_KING) ? 0
+                                                     : PIECE_VALUES[attacker];
+      scores[i] = gain * 100 - attackerValue;
+    }
+    stage = STAGE_CAPTURES;
+    [[fallthrough]];
+
+  case STAGE_CAPTURES:
+    if (pickBest(move))
+      return true;
+    if (capturesOnly) {
+      stage = STAGE_DONE;
+      return false;
+    }
+    stage = STAGE_KILLER_1;
+    [[fallthrough]];
+
+  case STAGE_KILLER_1:
+  case STAGE_KILLER_2:
+    // killers come from sibling positions, so they may be tactical moves
+    // or illegal here; tactical moves were already handed out above
+    while (stage != STAGE_GEN_QUIETS) {
+      const int k = stage - STAGE_KILLER_1;
+      ++stage;
+      const Move &killer = killers[k];
+      if (!(hashValid && killer == hashMove) &&
+          !(k == 1 && killerValid[0] && killer == killers[0]) &&
+          isLegalMove(state, killer) && !isTactical(state, killer)) {
+        killerValid[k] = true;
+        move = killer;
+        return true;
+      }
+    }
+    [[fallthrough]];
+
+  case STAGE_GEN_QUIETS:
+    generateMoves(state, moves, GEN_QUIETS);
+    for (int i = current; i < moves.size(); ++i) {
+      const int from = moves[i].from();
+      const int piece = state.board[from];
+      scores[i] = history ? history[piece][moves[i].to()] : 0;
+    }
+    stage = STAGE_QUIETS;
+    [[fallthrough]];
+
+  case STAGE_QUIETS:
+    if (pickBest(move))
+      return true;
+    stage = STAGE_DONE;
+    [[fallthrough]];
+
+  default:
+    return false;
+  }
+}
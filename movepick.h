@@ -0,0 +1,63 @@
+#pragma once
+#include "Moves.h"
+
+// Hands out the legal moves of a position one at a time, most promising
+// first, so a beta cutoff early in the list saves most of the work:
+//
+//   1. the hash move from the transposition table
+//   2. captures and queen promotions, most valuable victim (or promotion)
+//      first, cheapest attacker breaking ties (MVV-LVA)
+//   3. the killer moves: quiet moves that caused a cutoff at this ply in a
+//      sibling node
+//   4. the remaining quiet moves, highest history score first
+//
+// Captures are only generated once the hash move has been tried, and quiet
+// moves once the captures and killers have, so a cutoff skips the rest of
+// the generation. Each stage picks its best remaining move on demand rather
+// than sorting up front.
+class MovePicker {
+public:
+  // `killers` points at two moves; `history` is indexed [piece][to square].
+  // Either may hold moves from other positions: they are checked for
+  // legality before being returned.
+  MovePicker(const GameState &state, const Move &hashMove,
+             const Move *killers, const int (*history)[64]);
+
+  // For quiescence search: captures and queen promotions only, by MVV-LVA.
+  // When the side to move is in check, every evasion is returned instead,
+  // captures first.
+  MovePicker(const GameState &state, bool inCheck);
+
+  // Writes the next move and returns true, or returns false when none are
+  // left.
+  bool next(Move &move);
+
+private:
+  enum Stage {
+    STAGE_HASH,
+    STAGE_GEN_CAPTURES,
+    STAGE_CAPTURES,
+    STAGE_KILLER_1,
+    STAGE_KILLER_2,
+    STAGE_GEN_QUIETS,
+    STAGE_QUIETS,
+    STAGE_DONE
+  };
+
+  bool alreadyTried(const Move &move) const;
+  bool pickBest(Move &move);
+
+  const GameState &state;
+  Move hashMove;
+  Move killers[2];
+  const int (*history)[64];
+  bool capturesOnly = false;
+
+  int stage = STAGE_HASH;
+  bool hashValid = false;
+  bool killerValid[2] = {false, false};
+
+  MoveList moves;
+  int scores[MoveList::CAPACITY];
+  int current = 0; // next unpicked index in moves
+};
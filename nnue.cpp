@@ -0,0 +1,514 @@
+#include "nnue.h"
+#include "minimax.h"
+#include "pieces.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NNUE_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef DEBUG_EVAL
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#endif
+
+NNUENetwork NNUE;
+
+namespace {
+
+// Features per king square: 10 piece kinds (5 own, 5 the opponent's) on 64
+// squares, plus an unused first slot the format keeps.
+const int FEATURES_PER_KING = 641;
+const int FEATURES = 64 * FEATURES_PER_KING;
+const int L1 = 2 * NNUE_HALF_DIMS; // both accumulators
+const int L2 = 32;
+const int L3 = 32;
+
+const uint32_t FILE_VERSION = 0x7AF32F16;
+// The network's output is in 1/16 of Stockfish's internal units, where a pawn
+// is 208 in the endgame.
+const int OUTPUT_SCALE = 16;
+const int NETWORK_PAWN = 208;
+// Hidden layer sums are fixed point with 6 fractional bits.
+const int WEIGHT_SCALE_BITS = 6;
+// Evaluations stay clear of the tablebase and mate scores.
+const int SCORE_LIMIT = TB_WIN_SCORE - MAX_PLY - 1;
+
+// Order of the piece kinds in the features, by PieceIDs: pawn, knight,
+// bishop, rook, queen; kings are not features.
+const int FEATURE_KIND[13] = {-1, 0, 3, 1, 2, 4, -1, 0, 3, 1, 2, 4, -1};
+
+bool isKing(int piece) { return piece == W_KING || piece == B_KING; }
+
+// The feature of `piece` on `sq` for `perspective`, whose king is on
+// `kingSq`. The format numbers squares from a1, and Black sees the board
+// rotated, so both sides see their own pieces coming up from rank 1.
+int featureIndex(int perspective, int kingSq, int piece, int sq) {
+  const int orient = perspective == 0 ? 56 : 7; // white, black
+  const int kind =
+      2 * FEATURE_KIND[piece] + (colorOf(piece) != perspective);
+  return (sq ^ orient) + 1 + 64 * kind +
+         FEATURES_PER_KING * (kingSq ^ orient);
+}
+
+// The three operations inference spends its time in, one implementation per
+// instruction set.
+struct Kernels {
+  const char *name;
+  // acc = base + the added rows - the removed rows, NNUE_HALF_DIMS wide
+  void (*accumulate)(int16_t *acc, const int16_t *base,
+                     const int16_t *const *added, int addedCount,
+                     const int16_t *const *removed, int removedCount);
+  // both accumulators clipped to 0..127, `us` first
+  void (*clip)(const int16_t *us, const int16_t *them, uint8_t *out);
+  // out[i] = biases[i] + the dot product of row i of `weights` and `in`;
+  // inDims is a multiple of 32
+  void (*affine)(const uint8_t *in, int inDims, const int8_t *weights,
+                 const int32_t *biases, int outDims, int32_t *out);
+};
+
+void accumulateScalar(int16_t *acc, const int16_t *base,
+                      const int16_t *const *added, int addedCount,
+                      const int16_t *const *removed, int removedCount) {
+  // int16 sums wrap like the SIMD ones; a sensible network never gets there
+  std::copy(base, base + NNUE_HALF_DIMS, acc);
+  for (int r = 0; r < addedCount; ++r) {
+    for (int i = 0; i < NNUE_HALF_DIMS; ++i)
+      acc[i] = int16_t(acc[i] + added[r][i]);
+  }
+  for (int r = 0; r < removedCount; ++r) {
+    for (int i = 0; i < NNUE_HALF_DIMS; ++i)
+      acc[i] = int16_t(acc[i] - removed[r][i]);
+  }
+}
+
+void clipScalar(const int16_t *us, const int16_t *them, uint8_t *out) {
+  for (int i = 0; i < NNUE_HALF_DIMS; ++i) {
+    out[i] = uint8_t(std::clamp<int>(us[i], 0, 127));
+    out[NNUE_HALF_DIMS + i] = uint8_t(std::clamp<int>(them[i], 0, 127));
+  }
+}
+
+void affineScalar(const uint8_t *in, int inDims, const int8_t *weights,
+                  const int32_t *biases, int outDims, int32_t *out) {
+  for (int i = 0; i < outDims; ++i) {
+    int32_t sum = biases[i];
+    const int8_t *row = weights + i * inDims;
+    for (int j = 0; j < inDims; ++j)
+      sum += in[j] * row[j];
+    out[i] = sum;
+  }
+}
+
+const Kernels SCALAR_KERNELS = {"scalar", accumulateScalar, clipScalar,
+                                affineScalar};
+
+#ifdef NNUE_X86
+
+// The accumulator is 256 int16, 16 per AVX2 register: it is done in four
+// chunks of four registers so every row is read once.
+__attribute__((target("avx2"))) void
+accumulateAvx2(int16_t *acc, const int16_t *base, const int16_t *const *added,
+               int addedCount, const int16_t *const *removed,
+               int removedCount) {
+  for (int c = 0; c < NNUE_HALF_DIMS; c += 64) {
+    __m256i sum[4];
+    for (int k = 0; k < 4; ++k)
+      sum[k] = _mm256_loadu_si256((const __m256i *)(base + c + 16 * k));
+    for (int r = 0; r < addedCount; ++r) {
+      for (int k = 0; k < 4; ++k)
+        sum[k] = _mm256_add_epi16(
+            sum[k],
+            _mm256_loadu_si256((const __m256i *)(added[r] + c + 16 * k)));
+    }
+    for (int r = 0; r < removedCount; ++r) {
+      for (int k = 0; k < 4; ++k)
+        sum[k] = _mm256_sub_epi16(
+            sum[k],
+            _mm256_loadu_si256((const __m256i *)(removed[r] + c + 16 * k)));
+    }
+    for (int k = 0; k < 4; ++k)
+      _mm256_storeu_si256((__m256i *)(acc + c + 16 * k), sum[k]);
+  }
+}
+
+__attribute__((target("avx2"))) void clipAvx2(const int16_t *us,
+                                              const int16_t *them,
+                                              uint8_t *out) {
+  const int16_t *halves[2] = {us, them};
+  const __m256i zero = _mm256_setzero_si256();
+  for (int h = 0; h < 2; ++h) {
+    for (int i = 0; i < NNUE_HALF_DIMS; i += 32) {
+      const __m256i a = _mm256_loadu_si256((const __m256i *)(halves[h] + i));
+      const __m256i b =
+          _mm256_loadu_si256((const __m256i *)(halves[h] + i + 16));
+      // packs saturates to -128..127 per 128-bit lane; put the lanes back
+      // in order after dropping the negatives
+      const __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(a, b), zero);
+      _mm256_storeu_si256(
+          (__m256i *)(out + h * NNUE_HALF_DIMS + i),
+          _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+  }
+}
+
+// maddubs multiplies bytes and adds neighbouring pairs into int16, which
+// saturates only past 32767: the inputs are clipped to 0..127, so two
+// products stay within 2 * 127 * 128 and the sums match the scalar ones.
+__attribute__((target("avx2"))) void
+affineAvx2(const uint8_t *in, int inDims, const int8_t *weights,
+           const int32_t *biases, int outDims, int32_t *out) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  for (int i = 0; i < outDims; ++i) {
+    const int8_t *row = weights + i * inDims;
+    __m256i sum = _mm256_setzero_si256();
+    for (int j = 0; j < inDims; j += 32) {
+      const __m256i x = _mm256_loadu_si256((const __m256i *)(in + j));
+      const __m256i w = _mm256_loadu_si256((const __m256i *)(row + j));
+      sum = _mm256_add_epi32(
+          sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                 _mm256_extracti128_si256(sum, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+    out[i] = biases[i] + _mm_cvtsi128_si32(half);
+  }
+}
+
+__attribute__((target("sse4.1"))) void
+accumulateSse41(int16_t *acc, const int16_t *base,
+                const int16_t *const *added, int addedCount,
+                const int16_t *const *removed, int removedCount) {
+  for (int c = 0; c < NNUE_HALF_DIMS; c += 64) {
+    __m128i sum[8];
+    for (int k = 0; k < 8; ++k)
+      sum[k] = _mm_loadu_si128((const __m128i *)(base + c + 8 * k));
+    for (int r = 0; r < addedCount; ++r) {
+      for (int k = 0; k < 8; ++k)
+        sum[k] = _mm_add_epi16(
+            sum[k], _mm_loadu_si128((const __m128i *)(added[r] + c + 8 * k)));
+    }
+    for (int r = 0; r < removedCount; ++r) {
+      for (int k = 0; k < 8; ++k)
+        sum[k] = _mm_sub_epi16(
+            sum[k],
+            _mm_loadu_si128((const __m128i *)(removed[r] + c + 8 * k)));
+    }
+    for (int k = 0; k < 8; ++k)
+      _mm_storeu_si128((__m128i *)(acc + c + 8 * k), sum[k]);
+  }
+}
+
+__attribute__((target("sse4.1"))) void clipSse41(const int16_t *us,
+                                                 const int16_t *them,
+                                                 uint8_t *out) {
+  const int16_t *halves[2] = {us, them};
+  const __m128i zero = _mm_setzero_si128();
+  for (int h = 0; h < 2; ++h) {
+    for (int i = 0; i < NNUE_HALF_DIMS; i += 16) {
+      const __m128i a = _mm_loadu_si128((const __m128i *)(halves[h] + i));
+      const __m128i b = _mm_loadu_si128((const __m128i *)(halves[h] + i + 8));
+      _mm_storeu_si128((__m128i *)(out + h * NNUE_HALF_DIMS + i),
+                       _mm_max_epi8(_mm_packs_epi16(a, b), zero));
+    }
+  }
+}
+
+__attribute__((target("sse4.1"))) void
+affineSse41(const uint8_t *in, int inDims, const int8_t *weights,
+            const int32_t *biases, int outDims, int32_t *out) {
+  const __m128i ones = _mm_set1_epi16(1);
+  for (int i = 0; i < outDims; ++i) {
+    const int8_t *row = weights + i * inDims;
+    __m128i sum = _mm_setzero_si128();
+    for (int j = 0; j < inDims; j += 16) {
+      const __m128i x = _mm_loadu_si128((const __m128i *)(in + j));
+      const __m128i w = _mm_loadu_si128((const __m128i *)(row + j));
+      sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(x, w), ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    out[i] = biases[i] + _mm_cvtsi128_si32(sum);
+  }
+}
+
+const Kernels AVX2_KERNELS = {"avx2", accumulateAvx2, clipAvx2, affineAvx2};
+const Kernels SSE41_KERNELS = {"sse4.1", accumulateSse41, clipSse41,
+                               affineSse41};
+
+#endif // NNUE_X86
+
+const Kernels *kernels = &SCALAR_KERNELS;
+
+// The file is little-endian whatever the machine.
+template <typename T> bool readArray(std::istream &in, std::vector<T> &out) {
+  std::vector<unsigned char> bytes(out.size() * sizeof(T));
+  if (!in.read(reinterpret_cast<char *>(bytes.data()), bytes.size()))
+    return false;
+  for (std::size_t i = 0; i < out.size(); ++i) {
+    uint64_t v = 0;
+    for (int b = int(sizeof(T)) - 1; b >= 0; --b)
+      v = v << 8 | bytes[i * sizeof(T) + b];
+    out[i] = T(v);
+  }
+  return true;
+}
+
+bool readUint32(std::istream &in, uint32_t &value) {
+  std::vector<uint32_t> one(1);
+  if (!readArray(in, one))
+    return false;
+  value = one[0];
+  return true;
+}
+
+} // namespace
+
+struct NNUENetwork::Parameters {
+  std::vector<int16_t> ftBiases = std::vector<int16_t>(NNUE_HALF_DIMS);
+  std::vector<int16_t> ftWeights =
+      std::vector<int16_t>(std::size_t(FEATURES) * NNUE_HALF_DIMS);
+  std::vector<int32_t> biases1 = std::vector<int32_t>(L2);
+  std::vector<int8_t> weights1 = std::vector<int8_t>(L2 * L1);
+  std::vector<int32_t> biases2 = std::vector<int32_t>(L3);
+  std::vector<int8_t> weights2 = std::vector<int8_t>(L3 * L2);
+  std::vector<int32_t> biases3 = std::vector<int32_t>(1);
+  std::vector<int8_t> weights3 = std::vector<int8_t>(L3);
+
+  const int16_t *row(int feature) const {
+    return ftWeights.data() + std::size_t(feature) * NNUE_HALF_DIMS;
+  }
+};
+
+NNUENetwork::NNUENetwork() { selectKernels("auto"); }
+NNUENetwork::~NNUENetwork() = default;
+
+bool NNUENetwork::selectKernels(const std::string &name) {
+#ifdef NNUE_X86
+  __builtin_cpu_init();
+  const bool avx2 = __builtin_cpu_supports("avx2");
+  const bool sse41 = __builtin_cpu_supports("sse4.1");
+  if ((name == "auto" || name == "avx2") && avx2)
+    kernels = &AVX2_KERNELS;
+  else if ((name == "auto" || name == "sse4.1") && sse41)
+    kernels = &SSE41_KERNELS;
+  else if (name == "auto" || name == "scalar")
+    kernels = &SCALAR_KERNELS;
+  else
+    return false;
+  return true;
+#else
+  if (name != "auto" && name != "scalar")
+    return false;
+  kernels = &SCALAR_KERNELS;
+  return true;
+#endif
+}
+
+const char *NNUENetwork::kernelName() const { return kernels->name; }
+
+// Layout: version, hash and a description; the first layer's hash, biases
+// and weights (by feature); then a hash and each hidden layer's biases and
+// weights (by output), nearest the input first. The hashes only identify the
+// architecture, which the sizes check as well, so they are not compared.
+bool NNUENetwork::load(const std::string &path) {
+  unload();
+  std::ifstream in(path, std::ios::binary);
+  uint32_t version, hash, descriptionLength;
+  if (!in || !readUint32(in, version) || version != FILE_VERSION ||
+      !readUint32(in, hash) || !readUint32(in, descriptionLength))
+    return false;
+  in.ignore(descriptionLength);
+
+  auto p = std::make_unique<Parameters>();
+  if (!readUint32(in, hash) || !readArray(in, p->ftBiases) ||
+      !readArray(in, p->ftWeights) || !readUint32(in, hash) ||
+      !readArray(in, p->biases1) || !readArray(in, p->weights1) ||
+      !readArray(in, p->biases2) || !readArray(in, p->weights2) ||
+      !readArray(in, p->biases3) || !readArray(in, p->weights3))
+    return false;
+  // a larger network would have read this far too
+  if (in.peek() != std::ifstream::traits_type::eof())
+    return false;
+
+  params = std::move(p);
+  loaded = true;
+  return true;
+}
+
+// Weights in the ranges trained networks use, small enough that the sums
+// stay clear of int16 overflow.
+void NNUENetwork::loadRandom(uint32_t seed) {
+  unload();
+  std::mt19937 rng(seed);
+  auto fill = [&rng](auto &values, int low, int high) {
+    std::uniform_int_distribution<int> pick(low, high);
+    for (auto &value : values)
+      value = pick(rng);
+  };
+  auto p = std::make_unique<Parameters>();
+  fill(p->ftBiases, 0, 60);
+  fill(p->ftWeights, -16, 15);
+  fill(p->biases1, -500, 500);
+  fill(p->weights1, -128, 127);
+  fill(p->biases2, -500, 500);
+  fill(p->weights2, -128, 127);
+  fill(p->biases3, -500, 500);
+  fill(p->weights3, -128, 127);
+  params = std::move(p);
+  loaded = true;
+}
+
+void NNUENetwork::unload() {
+  params.reset();
+  loaded = false;
+}
+
+void NNUENetwork::refresh(const GameState &state, int perspective,
+                          NNUEAccumulator &acc) const {
+  const int16_t *rows[32];
+  int count = 0;
+  const int kingSq = state.kingSquare[perspective];
+  Bitboard pieces = state.occupied;
+  while (pieces) {
+    const int sq = popLsb(pieces);
+    const int piece = state.board[sq];
+    if (!isKing(piece))
+      rows[count++] = params->row(featureIndex(perspective, kingSq, piece, sq));
+  }
+  kernels->accumulate(acc.values[perspective], params->ftBiases.data(), rows,
+                      count, nullptr, 0);
+  acc.computed[perspective] = true;
+}
+
+void NNUENetwork::update(const NNUEAccumulator &from, int perspective,
+                         int kingSq, NNUEAccumulator &to) const {
+  const int16_t *added[3], *removed[3];
+  int addedCount = 0, removedCount = 0;
+  for (int i = 0; i < to.dirtyCount; ++i) {
+    const DirtyPiece &d = to.dirty[i];
+    if (isKing(d.piece))
+      continue;
+    if (d.from >= 0)
+      removed[removedCount++] =
+          params->row(featureIndex(perspective, kingSq, d.piece, d.from));
+    if (d.to >= 0)
+      added[addedCount++] =
+          params->row(featureIndex(perspective, kingSq, d.piece, d.to));
+  }
+  kernels->accumulate(to.values[perspective], from.values[perspective], added,
+                      addedCount, removed, removedCount);
+  to.computed[perspective] = true;
+}
+
+// Finds the nearest ply back whose accumulator is known, and applies the
+// moves since. If `perspective`'s king moved on the way, its features all
+// changed and the board is quicker.
+void NNUENetwork::bringUpToDate(const GameState &state,
+                                NNUEAccumulator *stack, int ply,
+                                int perspective) const {
+  int source = ply;
+  while (!stack[source].computed[perspective]) {
+    if (source == 0 || stack[source].kingMoved[perspective]) {
+      refresh(state, perspective, stack[ply]);
+      return;
+    }
+    --source;
+  }
+  for (int i = source + 1; i <= ply; ++i)
+    update(stack[i - 1], perspective, state.kingSquare[perspective],
+           stack[i]);
+}
+
+int NNUENetwork::propagate(const NNUEAccumulator &acc, int sideToMove) const {
+  alignas(32) uint8_t input[L1];
+  kernels->clip(acc.values[sideToMove], acc.values[sideToMove ^ 1], input);
+
+  int32_t sums[L2];
+  alignas(32) uint8_t hidden1[L2], hidden2[L3];
+  kernels->affine(input, L1, params->weights1.data(), params->biases1.data(),
+                  L2, sums);
+  for (int i = 0; i < L2; ++i)
+    hidden1[i] = uint8_t(std::clamp(sums[i] >> WEIGHT_SCALE_BITS, 0, 127));
+  kernels->affine(hidden1, L2, params->weights2.data(),
+                  params->biases2.data(), L3, sums);
+  for (int i = 0; i < L3; ++i)
+    hidden2[i] = uint8_t(std::clamp(sums[i] >> WEIGHT_SCALE_BITS, 0, 127));
+  int32_t output;
+  kernels->affine(hidden2, L3, params->weights3.data(),
+                  params->biases3.data(), 1, &output);
+
+  const int score = output * 100 / (OUTPUT_SCALE * NETWORK_PAWN);
+  return std::clamp(score, -SCORE_LIMIT, SCORE_LIMIT);
+}
+
+int NNUENetwork::evaluate(const GameState &state, NNUEAccumulator *stack,
+                          int ply) const {
+  for (int perspective = 0; perspective < 2; ++perspective) {
+    if (!stack[ply].computed[perspective])
+      bringUpToDate(state, stack, ply, perspective);
+  }
+#ifdef DEBUG_EVAL
+  NNUEAccumulator full;
+  refresh(state, 0, full);
+  refresh(state, 1, full);
+  if (std::memcmp(full.values, stack[ply].values, sizeof(full.values)) != 0) {
+    std::cerr << "incremental NNUE accumulator out of sync at ply " << ply
+              << std::endl;
+    std::abort();
+  }
+#endif
+  return propagate(stack[ply], state.sideToMove);
+}
+
+int NNUENetwork::evaluate(const GameState &state) const {
+  NNUEAccumulator acc;
+  refresh(state, 0, acc);
+  refresh(state, 1, acc);
+  return propagate(acc, state.sideToMove);
+}
+
+void resetAccumulator(NNUEAccumulator &root) {
+  root.computed[0] = root.computed[1] = false;
+  root.dirtyCount = 0;
+  root.kingMoved[0] = root.kingMoved[1] = false;
+}
+
+void recordMove(NNUEAccumulator &next, const GameState &state,
+                const Undo &undo) {
+  const Move &move = undo.move;
+  const int from = move.from(), to = move.to();
+  const int moved = undo.movedPiece;
+  next.computed[0] = next.computed[1] = false;
+  next.kingMoved[0] = next.kingMoved[1] = false;
+  if (isKing(moved))
+    next.kingMoved[colorOf(moved)] = true;
+
+  int n = 0;
+  if (move.isPromotion()) {
+    next.dirty[n++] = {int8_t(moved), int8_t(from), -1};
+    next.dirty[n++] = {state.board[to], -1, int8_t(to)};
+  } else {
+    next.dirty[n++] = {int8_t(moved), int8_t(from), int8_t(to)};
+  }
+  if (undo.capturedPiece != EMPTY) {
+    const int sq = move.flag() == MOVE_EN_PASSANT
+                       ? squareOf(fileOf(to), rowOf(from))
+                       : to;
+    next.dirty[n++] = {int8_t(undo.capturedPiece), int8_t(sq), -1};
+  } else if (move.flag() == MOVE_CASTLE) {
+    // the king lands on g or c; the rook comes from h or a to beside it
+    const bool kingside = to > from;
+    const int rookFrom = squareOf(kingside ? 7 : 0, rowOf(to));
+    const int rookTo = kingside ? to - 1 : to + 1;
+    next.dirty[n++] = {state.board[rookTo], int8_t(rookFrom), int8_t(rookTo)};
+  }
+  next.dirtyCount = n;
+}
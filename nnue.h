@@ -0,0 +1,103 @@
+#pragma once
+#include "Moves.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// NNUE evaluation: a small neural network whose first layer is updated move
+// by move instead of recomputed. The network is HalfKP 256x2-32-32-1, in the
+// .nnue format Stockfish 12 used, so those networks load as they are:
+//
+//  - Each side has a 256-wide accumulator: the sum of the first-layer rows
+//    of its features, one per (own king square, piece, square) for every
+//    piece but the kings. A move changes at most four features per side, so
+//    the accumulator is updated with a few row additions; only a king move
+//    makes that side start over from the board.
+//  - The two accumulators, side to move first, are clipped to 0..127 and go
+//    through two 32-wide hidden layers to one output.
+//
+// The arithmetic is integer throughout, so the AVX2, SSE4.1 and plain C++
+// kernels give the same result; the fastest one the CPU supports is chosen
+// when a network is loaded.
+
+// Width of one side's accumulator.
+const int NNUE_HALF_DIMS = 256;
+
+// One feature changing: `piece` leaves `from` and/or lands on `to` (-1 when
+// it only appears or only disappears).
+struct DirtyPiece {
+  int8_t piece;
+  int8_t from;
+  int8_t to;
+};
+
+// One ply of a search line: the accumulators of the position there, computed
+// on first use from the ply before plus the pieces the move changed.
+struct NNUEAccumulator {
+  alignas(32) int16_t values[2][NNUE_HALF_DIMS]; // by colour (white 0)
+  bool computed[2];
+  DirtyPiece dirty[3]; // at most: the mover, a captured piece, a rook
+  int dirtyCount;
+  bool kingMoved[2];
+};
+
+class NNUENetwork {
+public:
+  NNUENetwork();
+  ~NNUENetwork();
+  NNUENetwork(const NNUENetwork &) = delete;
+  NNUENetwork &operator=(const NNUENetwork &) = delete;
+
+  // Reads the network at `path`, replacing any loaded one. Returns false
+  // (and leaves none loaded) if the file is missing or not a HalfKP
+  // 256x2-32-32-1 network.
+  bool load(const std::string &path);
+  // Fills the network with pseudo-random weights from `seed`, for checking
+  // the incremental updates and the kernels without a network file.
+  void loadRandom(uint32_t seed);
+  void unload();
+  bool isLoaded() const { return loaded; }
+
+  // Picks the inference kernels: "avx2", "sse4.1", "scalar", or "auto" for
+  // the fastest the CPU supports (the default). Returns false if the CPU
+  // (or the build) does not have the one asked for.
+  bool selectKernels(const std::string &name);
+  const char *kernelName() const;
+
+  // Score of `stack[ply]`'s position (`state`) for the side to move, in
+  // centipawns. stack[0] is the root; every later entry must have been
+  // filled by recordMove. Brings the accumulators up to date on the way.
+  int evaluate(const GameState &state, NNUEAccumulator *stack, int ply) const;
+
+  // The same from scratch, for a single position.
+  int evaluate(const GameState &state) const;
+
+private:
+  struct Parameters;
+
+  void refresh(const GameState &state, int perspective,
+               NNUEAccumulator &acc) const;
+  void update(const NNUEAccumulator &from, int perspective, int kingSq,
+              NNUEAccumulator &to) const;
+  void bringUpToDate(const GameState &state, NNUEAccumulator *stack, int ply,
+                     int perspective) const;
+  int propagate(const NNUEAccumulator &acc, int sideToMove) const;
+
+  std::unique_ptr<Parameters> params;
+  bool loaded = false;
+};
+
+// The network the search evaluates with; unloaded (and the handcrafted
+// evaluation used) unless a network file was given.
+extern NNUENetwork NNUE;
+
+// Marks the root of a search line: its accumulators are computed from the
+// board when first needed.
+void resetAccumulator(NNUEAccumulator &root);
+
+// Records in `next` what `undo`'s move changed, `state` being the position
+// after it. Cheap: the accumulators themselves are updated only if the new
+// position is evaluated.
+void recordMove(NNUEAccumulator &next, const GameState &state,
+                const Undo &undo);
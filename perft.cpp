@@ -0,0 +1,349 @@
+// Headless perft: counts the leaf nodes of the legal move tree to a fixed
+// depth, to check the move generator against known counts and to time it.
+//
+//   ./perft <depth> [fen]           count from the start position or a FEN
+//   ./perft divide <depth> [fen]    same, broken down by root move
+//   ./perft suite                   check the reference positions below, and
+//                                   the Polyglot key of the start position
+//   ./perft nnue                    check the incremental NNUE evaluation
+//                                   against a full one, with each kernel set
+//   ./perft syzygy <dir>            check the tablebase reader against known
+//                                   endgame results, with the Syzygy files in
+//                                   <dir> (KQvK, KRvK, KPvK and KRvKP at least)
+
+#include "Moves.h"
+#include "book.h"
+#include "fen.h"
+#include "nnue.h"
+#include "tablebase.h"
+#include "trace.h"
+
+#include <chrono>
+#include <climits>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reference positions with their published counts (from the Chess
+// Programming Wiki's perft results). Between them they cover castling (and
+// losing the right to), en passant, promotion and underpromotion, and
+// discovered checks and pins.
+struct PerftCase {
+  const char *name;
+  const char *fen;
+  std::vector<unsigned long long> counts; // counts[d - 1] is perft(d)
+};
+
+static const PerftCase SUITE[] = {
+    {"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+     {20, 400, 8902, 197281, 4865609}},
+    {"kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+     {48, 2039, 97862, 4085603}},
+    {"position 3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+     {14, 191, 2812, 43238, 674624, 11030083}},
+    {"position 4",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+     {6, 264, 9467, 422333}},
+    {"position 4 mirrored",
+     "r2q1rk1/pP1p2pp/Q4n2/bbp1p3/Np6/1B3NBn/pPPP1PPP/R3K2R b KQ - 0 1",
+     {6, 264, 9467, 422333}},
+    {"position 5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+     {44, 1486, 62379, 2103487}},
+    {"position 6",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 "
+     "10",
+     {46, 2079, 89890, 3894594}},
+};
+
+// Endgames with their results for the side to move: win, draw or loss, and
+// the exact plies to the next capture or pawn move (negative when losing).
+// They include the longest wins of KQvK and KRvK, the published mate in 10
+// and in 16 (19 and 31 plies), and of KPvK and KRvKP; stalemate; the
+// textbook king and pawn draws and wins; and a pawn that promotes by taking
+// the rook. The other distances come from solving these endgames backwards
+// from mate, independently of the reader.
+struct TablebaseCase {
+  const char *fen;
+  WDLScore wdl;
+  int dtz;
+};
+
+static const TablebaseCase TABLEBASE_SUITE[] = {
+    {"8/8/4k3/8/8/8/1Q6/K7 w - - 0 1", WDL_WIN, 19},
+    {"8/3k4/8/8/8/8/1Q6/K7 b - - 0 1", WDL_LOSS, -20},
+    {"k7/8/1QK5/8/8/8/8/8 b - - 0 1", WDL_DRAW, 0},
+    {"8/8/8/8/8/2k5/1Q6/7K b - - 0 1", WDL_DRAW, 0},
+    {"2R5/3k4/8/8/8/8/8/K7 w - - 0 1", WDL_WIN, 31},
+    {"3k1R2/8/8/8/8/8/8/K7 b - - 0 1", WDL_LOSS, -32},
+    {"k7/8/1K6/8/8/8/8/7R w - - 0 1", WDL_WIN, 1},
+    {"8/8/8/8/8/2k5/1R6/7K b - - 0 1", WDL_DRAW, 0},
+    {"8/8/k7/8/8/K4P2/8/8 w - - 0 1", WDL_WIN, 19},
+    {"8/k7/8/8/K7/6P1/8/8 b - - 0 1", WDL_LOSS, -20},
+    {"8/8/8/8/8/4k3/4P3/4K3 w - - 0 1", WDL_DRAW, 0},
+    {"4k3/8/4K3/4P3/8/8/8/8 w - - 0 1", WDL_WIN, 3},
+    {"4k3/8/4K3/4P3/8/8/8/8 b - - 0 1", WDL_LOSS, -4},
+    {"k7/8/1K6/P7/8/8/8/8 w - - 0 1", WDL_DRAW, 0},
+    {"K7/8/7p/R7/7k/8/8/8 w - - 0 1", WDL_WIN, 25},
+    {"K7/1R6/4k1p1/8/8/8/8/8 b - - 0 1", WDL_LOSS, -24},
+    {"8/8/8/8/8/1k6/2p5/K6R w - - 0 1", WDL_WIN, 5},
+    {"8/8/8/8/8/1k6/2p5/K6R b - - 0 1", WDL_LOSS, -8},
+    {"8/8/8/8/8/K7/5kp1/7R w - - 0 1", WDL_DRAW, 0},
+    {"8/8/8/8/8/K7/5kp1/7R b - - 0 1", WDL_WIN, 1},
+    {"7K/8/8/8/8/8/1kp5/3R4 w - - 0 1", WDL_DRAW, 0},
+};
+
+static unsigned long long perft(GameState &state, int depth) {
+  MoveList moves;
+  generateAllMoves(state, moves);
+  if (depth <= 1)
+    return depth == 1 ? moves.size() : 1; // bulk-count the last ply
+
+  unsigned long long nodes = 0;
+  for (const Move &move : moves) {
+    Undo undo;
+    doMove(state, move, undo);
+    nodes += perft(state, depth - 1);
+    undoMove(state, undo);
+  }
+  return nodes;
+}
+
+// Runs perft (or divide) and returns the node count and elapsed time.
+static unsigned long long timedPerft(GameState &state, int depth,
+                                     long long &us, bool divide) {
+  std::vector<std::pair<std::string, unsigned long long>> perMove;
+  const auto start = std::chrono::steady_clock::now();
+
+  unsigned long long nodes = 0;
+  if (divide) {
+    MoveList moves;
+    generateAllMoves(state, moves);
+    for (const Move &move : moves) {
+      Undo undo;
+      doMove(state, move, undo);
+      unsigned long long count = depth > 1 ? perft(state, depth - 1) : 1;
+      undoMove(state, undo);
+      perMove.push_back({moveToString(move), count});
+      nodes += count;
+    }
+  } else {
+    nodes = perft(state, depth);
+  }
+
+  us = std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now() - start)
+           .count();
+  for (const auto &entry : perMove)
+    std::cout << entry.first << ": " << entry.second << std::endl;
+  return nodes;
+}
+
+static unsigned long long nodesPerSecond(unsigned long long nodes,
+                                         long long us) {
+  return (unsigned long long)(nodes * 1e6 / (us > 0 ? us : 1));
+}
+
+static int runSuite() {
+  int failures = 0;
+  unsigned long long totalNodes = 0;
+  long long totalUs = 0;
+
+  for (const PerftCase &test : SUITE) {
+    GameState state;
+    if (!parseFEN(test.fen, state)) {
+      std::cerr << "bad FEN in suite: " << test.fen << std::endl;
+      return 1;
+    }
+    std::cout << test.name << std::endl;
+
+    for (std::size_t d = 1; d <= test.counts.size(); ++d) {
+      long long us = 0;
+      unsigned long long nodes = timedPerft(state, (int)d, us, false);
+      bool ok = nodes == test.counts[d - 1];
+      if (!ok)
+        ++failures;
+      totalNodes += nodes;
+      totalUs += us;
+
+      std::cout << "  depth " << d << ": " << nodes;
+      if (!ok)
+        std::cout << " (expected " << test.counts[d - 1] << ")";
+      std::cout << (ok ? "  ok  " : "  FAIL  ") << us / 1000 << " ms, "
+                << nodesPerSecond(nodes, us) << " nodes/sec" << std::endl;
+    }
+  }
+
+  const bool keysOk = hasStandardPolyglotKeys();
+  if (!keysOk)
+    ++failures;
+  std::cout << "polyglot start key" << (keysOk ? "  ok" : "  FAIL")
+            << std::endl;
+
+  std::cout << (failures ? "FAILED " : "passed ") << "(" << failures
+            << " failures) " << totalNodes << " nodes in " << totalUs / 1000
+            << " ms, " << nodesPerSecond(totalNodes, totalUs) << " nodes/sec"
+            << std::endl;
+  return failures ? 1 : 0;
+}
+
+// Walks the tree like perft, but evaluates every node with the network twice:
+// from the accumulators updated move by move, and from scratch. Counts the
+// nodes where they differ; adds the scratch scores to `sum`.
+static unsigned long long checkNNUE(GameState &state, NNUEAccumulator *stack,
+                                    int ply, int depth,
+                                    unsigned long long &nodes, long long &sum) {
+  const int full = NNUE.evaluate(state);
+  unsigned long long mismatches = NNUE.evaluate(state, stack, ply) != full;
+  ++nodes;
+  sum += full;
+  if (depth == 0)
+    return mismatches;
+
+  MoveList moves;
+  generateAllMoves(state, moves);
+  for (const Move &move : moves) {
+    Undo undo;
+    doMove(state, move, undo);
+    recordMove(stack[ply + 1], state, undo);
+    mismatches += checkNNUE(state, stack, ply + 1, depth - 1, nodes, sum);
+    undoMove(state, undo);
+  }
+  return mismatches;
+}
+
+// Runs checkNNUE to depth 3 from the reference positions with a random
+// network, for each kernel set the CPU has. The kernels must also agree
+// with each other, so the sums of their scores are compared.
+static int runNNUECheck() {
+  const int depth = 3;
+  NNUE.loadRandom(1);
+  std::unique_ptr<NNUEAccumulator[]> stack(new NNUEAccumulator[depth + 1]);
+  int failures = 0;
+  bool haveSum = false;
+  long long firstSum = 0;
+
+  for (const char *kernels : {"scalar", "sse4.1", "avx2"}) {
+    if (!NNUE.selectKernels(kernels)) {
+      std::cout << kernels << "  not supported" << std::endl;
+      continue;
+    }
+    unsigned long long nodes = 0, mismatches = 0;
+    long long sum = 0;
+    for (const PerftCase &test : SUITE) {
+      GameState state;
+      parseFEN(test.fen, state);
+      resetAccumulator(stack[0]);
+      mismatches += checkNNUE(state, stack.get(), 0, depth, nodes, sum);
+    }
+    if (!haveSum) {
+      haveSum = true;
+      firstSum = sum;
+    }
+    const bool ok = !mismatches && sum == firstSum;
+    if (!ok)
+      ++failures;
+    std::cout << kernels << ": " << nodes << " nodes, " << mismatches
+              << " mismatches, score sum " << sum << (ok ? "  ok" : "  FAIL")
+              << std::endl;
+  }
+
+  std::cout << (failures ? "FAILED " : "passed ") << "(" << failures
+            << " failures)" << std::endl;
+  return failures ? 1 : 0;
+}
+
+// Probes every TABLEBASE_SUITE position with the tables in `paths`.
+static int runTablebaseCheck(const std::string &paths) {
+  if (initTablebases(paths) == 0) {
+    std::cerr << "no tablebases in " << paths << std::endl;
+    return 1;
+  }
+
+  int failures = 0;
+  for (const TablebaseCase &test : TABLEBASE_SUITE) {
+    GameState state;
+    parseFEN(test.fen, state);
+    WDLScore wdl;
+    int dtz;
+    bool rounded;
+    const bool found =
+        probeWDL(state, wdl) && probeDTZ(state, dtz, &rounded);
+    // only a distance read from a table that keeps it in moves may be a
+    // ply short
+    const int shorter = test.dtz - (test.dtz > 0) + (test.dtz < 0);
+    const bool ok = found && wdl == test.wdl &&
+                    (dtz == test.dtz || (rounded && dtz == shorter));
+    if (!ok)
+      ++failures;
+
+    std::cout << test.fen << ": ";
+    if (found)
+      std::cout << "wdl " << wdl << " dtz " << dtz;
+    else
+      std::cout << "missing table";
+    if (!ok)
+      std::cout << " (expected wdl " << test.wdl << " dtz " << test.dtz << ")";
+    std::cout << (ok ? "  ok" : "  FAIL") << std::endl;
+  }
+
+  std::cout << (failures ? "FAILED " : "passed ") << "(" << failures
+            << " failures)" << std::endl;
+  return failures ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+  if (args.empty()) {
+    std::cerr << "usage: perft <depth> [fen] | perft divide <depth> [fen] | "
+                 "perft suite | perft nnue | perft syzygy <dir>"
+              << std::endl;
+    return 1;
+  }
+  if (args[0] == "suite")
+    return runSuite();
+  if (args[0] == "nnue")
+    return runNNUECheck();
+  if (args[0] == "syzygy") {
+    if (args.size() < 2) {
+      std::cerr << "missing tablebase directory" << std::endl;
+      return 1;
+    }
+    return runTablebaseCheck(args[1]);
+  }
+
+  const bool divide = args[0] == "divide";
+  if (divide)
+    args.erase(args.begin());
+  if (args.empty()) {
+    std::cerr << "missing depth" << std::endl;
+    return 1;
+  }
+
+  long long depth;
+  if (!parseCount(args[0], INT_MAX, depth)) {
+    std::cerr << "bad depth: " << args[0] << std::endl;
+    return 1;
+  }
+  std::string fen = START_FEN;
+  if (args.size() > 1) {
+    // let the FEN be passed unquoted, as separate arguments
+    fen.clear();
+    for (std::size_t i = 1; i < args.size(); ++i)
+      fen += (i > 1 ? " " : "") + args[i];
+  }
+
+  GameState state;
+  if (!parseFEN(fen, state)) {
+    std::cerr << "bad FEN: " << fen << std::endl;
+    return 1;
+  }
+
+  long long us = 0;
+  unsigned long long nodes = timedPerft(state, int(depth), us, divide);
+  std::cout << "Nodes: " << nodes << " in " << us / 1000 << " ms ("
+            << nodesPerSecond(nodes, us) << " nodes/sec)" << std::endl;
+  dumpTrace(std::cout);
+  return 0;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// What occupies a square of GameState::board. The sprite atlas and the
+// evaluation tables are indexed by these values too.
+enum PieceIDs {
+  EMPTY = 0,
+  W_PAWN = 1,
+  W_ROOK = 2,
+  W_KNIGHT = 3,
+  W_BISHOP = 4,
+  W_QUEEN = 5,
+  W_KING = 6,
+  B_PAWN = 7,
+  B_ROOK = 8,
+  B_KNIGHT = 9,
+  B_BISHOP = 10,
+  B_QUEEN = 11,
+  B_KING = 12
+};
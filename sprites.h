@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+
+// A file compiled into the program by the build (see embed.cpp).
+struct EmbeddedFile {
+  const unsigned char *data;
+  std::size_t size;
+};
+
+// The piece sprites as PNG data, W_PAWN to B_KING in PieceIDs order, so the
+// sprite for piece `id` is PIECE_SPRITES[id - 1]. The makefile generates the
+// definition (sprites_data.cpp) from the files in sprites/.
+extern const EmbeddedFile PIECE_SPRITES[12];
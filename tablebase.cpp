@@ -0,0 +1,1132 @@
+// Syzygy tablebase probing. The file format is Ronald de Man's; the reading
+// code is adapted from Fathom's tbprobe.c, which carries this notice:
+//
+//   The MIT License (MIT)
+//
+//   Copyright (c) 2013-2018 Ronald de Man
+//   Copyright (c) 2015 basil00
+//   Modifications Copyright (c) 2016-2019 by Jon Dart
+//
+//   Permission is hereby granted, free of charge, to any person obtaining a
+//   copy of this software and associated documentation files (the
+//   "Software"), to deal in the Software without restriction, including
+//   without limitation the rights to use, copy, modify, merge, publish,
+//   distribute, sublicense, and/or sell copies of the Software, and to
+//   permit persons to whom the Software is furnished to do so, subject to
+//   the following conditions:
+//
+//   The above copyright notice and this permission notice shall be included
+//   in all copies or substantial portions of the Software.
+//
+//   THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+//   OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//   MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+//   IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+//   CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+//   TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//   SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "tablebase.h"
+#include "pieces.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const int TB_PIECES = 7; // the largest tables published
+
+// The files number squares from a1 = 0 up to h8 = 63 (ours start at a8),
+// and pieces 1-6 (pawn, knight, bishop, rook, queen, king) for white and
+// 9-14 for black.
+int tbSquare(int sq) { return sq ^ 56; }
+const int TB_PIECE[13] = {0, 1, 4, 2, 3, 5, 6, 9, 12, 10, 11, 13, 14};
+const int ENGINE_PIECE[16] = {EMPTY,  W_PAWN,   W_KNIGHT, W_BISHOP,
+                              W_ROOK, W_QUEEN,  W_KING,   EMPTY,
+                              EMPTY,  B_PAWN,   B_KNIGHT, B_BISHOP,
+                              B_ROOK, B_QUEEN,  B_KING,   EMPTY};
+const int TB_PAWN = 1;
+
+enum TableType { WDL, DTZ };
+
+// How a table indexes its leading pieces: by the symmetries of the whole
+// board, or (with pawns) by the file of the leading pawn.
+enum Encoding { PIECE_ENC, FILE_ENC };
+
+// Which side of the a1-h8 diagonal a square is on: below (-1), on it (0)
+// or above (1).
+const int8_t OFF_DIAG[64] = {
+     0, -1, -1, -1, -1, -1, -1, -1,
+     1,  0, -1, -1, -1, -1, -1, -1,
+     1,  1,  0, -1, -1, -1, -1, -1,
+     1,  1,  1,  0, -1, -1, -1, -1,
+     1,  1,  1,  1,  0, -1, -1, -1,
+     1,  1,  1,  1,  1,  0, -1, -1,
+     1,  1,  1,  1,  1,  1,  0, -1,
+     1,  1,  1,  1,  1,  1,  1,  0,
+};
+
+// The square of the a1-d1-d4 triangle each square maps to by symmetry,
+// off-diagonal squares first.
+const uint8_t TRIANGLE[64] = {
+    6, 0, 1, 2, 2, 1, 0, 6,
+    0, 7, 3, 4, 4, 3, 7, 0,
+    1, 3, 8, 5, 5, 8, 3, 1,
+    2, 4, 5, 9, 9, 5, 4, 2,
+    2, 4, 5, 9, 9, 5, 4, 2,
+    1, 3, 8, 5, 5, 8, 3, 1,
+    0, 7, 3, 4, 4, 3, 7, 0,
+    6, 0, 1, 2, 2, 1, 0, 6,
+};
+
+const uint8_t FLIP_DIAG[64] = {
+     0,  8, 16, 24, 32, 40, 48, 56,
+     1,  9, 17, 25, 33, 41, 49, 57,
+     2, 10, 18, 26, 34, 42, 50, 58,
+     3, 11, 19, 27, 35, 43, 51, 59,
+     4, 12, 20, 28, 36, 44, 52, 60,
+     5, 13, 21, 29, 37, 45, 53, 61,
+     6, 14, 22, 30, 38, 46, 54, 62,
+     7, 15, 23, 31, 39, 47, 55, 63,
+};
+
+// The 28 squares below the diagonal (and their mirror images above it).
+const uint8_t LOWER[64] = {
+    28,  0,  1,  2,  3,  4,  5,  6,
+     0, 29,  7,  8,  9, 10, 11, 12,
+     1,  7, 30, 13, 14, 15, 16, 17,
+     2,  8, 13, 31, 18, 19, 20, 21,
+     3,  9, 14, 18, 32, 22, 23, 24,
+     4, 10, 15, 19, 22, 33, 25, 26,
+     5, 11, 16, 20, 23, 25, 34, 27,
+     6, 12, 17, 21, 24, 26, 27, 35,
+};
+
+const uint8_t DIAG[64] = {
+     0,  0,  0,  0,  0,  0,  0,  8,
+     0,  1,  0,  0,  0,  0,  9,  0,
+     0,  0,  2,  0,  0, 10,  0,  0,
+     0,  0,  0,  3, 11,  0,  0,  0,
+     0,  0,  0, 12,  4,  0,  0,  0,
+     0,  0, 13,  0,  0,  5,  0,  0,
+     0, 14,  0,  0,  0,  0,  6,  0,
+    15,  0,  0,  0,  0,  0,  0,  7,
+};
+
+// The leading pawn's square, by file (a-d) then rank.
+const uint8_t FLAP[64] = {
+     0,  0,  0,  0,  0,  0,  0,  0,
+     0,  6, 12, 18, 18, 12,  6,  0,
+     1,  7, 13, 19, 19, 13,  7,  1,
+     2,  8, 14, 20, 20, 14,  8,  2,
+     3,  9, 15, 21, 21, 15,  9,  3,
+     4, 10, 16, 22, 22, 16, 10,  4,
+     5, 11, 17, 23, 23, 17, 11,  5,
+     0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+// Pawn squares ordered so that the leading pawn (nearest the edge, then
+// lowest) comes highest.
+const uint8_t PAWN_TWIST[64] = {
+     0,  0,  0,  0,  0,  0,  0,  0,
+    47, 35, 23, 11, 10, 22, 34, 46,
+    45, 33, 21,  9,  8, 20, 32, 44,
+    43, 31, 19,  7,  6, 18, 30, 42,
+    41, 29, 17,  5,  4, 16, 28, 40,
+    39, 27, 15,  3,  2, 14, 26, 38,
+    37, 25, 13,  1,  0, 12, 24, 36,
+     0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+const uint8_t FILE_TO_FILE[8] = {0, 1, 2, 3, 3, 2, 1, 0};
+
+// The index tables that are computed rather than listed.
+struct Indices {
+  int kkIdx[10][64];         // two kings, the first in the triangle
+  uint64_t binomial[7][64];  // binomial[k][n]: ways to choose k of n
+  uint64_t pawnIdx[6][24];   // by leading pawns - 1, FLAP square
+  uint64_t pawnFactor[6][4]; // by leading pawns - 1, file
+
+  Indices() {
+    // kings that do not touch, the second not above the diagonal when the
+    // first is on it; both on the diagonal are numbered last
+    std::vector<std::pair<int, int>> onDiagonal;
+    int code = 0;
+    for (int t = 0; t < 10; ++t) {
+      int k1 = 0;
+      while (TRIANGLE[k1] != t || (k1 & 7) > 3 || OFF_DIAG[k1] > 0)
+        ++k1;
+      for (int k2 = 0; k2 < 64; ++k2) {
+        kkIdx[t][k2] = -1;
+        const int df = (k1 & 7) - (k2 & 7), dr = (k1 >> 3) - (k2 >> 3);
+        if (df >= -1 && df <= 1 && dr >= -1 && dr <= 1)
+          continue;
+        if (!OFF_DIAG[k1] && OFF_DIAG[k2] > 0)
+          continue;
+        if (!OFF_DIAG[k1] && !OFF_DIAG[k2])
+          onDiagonal.emplace_back(t, k2);
+        else
+          kkIdx[t][k2] = code++;
+      }
+    }
+    for (const auto &kings : onDiagonal)
+      kkIdx[kings.first][kings.second] = code++;
+
+    for (int k = 0; k < 7; ++k) {
+      for (int n = 0; n < 64; ++n) {
+        uint64_t f = 1, l = 1;
+        for (int i = 0; i < k; ++i) {
+          f *= n - i;
+          l *= i + 1;
+        }
+        binomial[k][n] = f / l;
+      }
+    }
+
+    for (int k = 0; k < 6; ++k) {
+      uint64_t s = 0;
+      for (int j = 0; j < 24; ++j) {
+        pawnIdx[k][j] = s;
+        s += binomial[k][PAWN_TWIST[(1 + j % 6) * 8 + j / 6]];
+        if ((j + 1) % 6 == 0) {
+          pawnFactor[k][j / 6] = s;
+          s = 0;
+        }
+      }
+    }
+  }
+};
+
+const Indices indices;
+
+// Little-endian numbers in the headers, big-endian in the compressed data.
+uint64_t readLittleEndian(const uint8_t *bytes, int length) {
+  uint64_t value = 0;
+  for (int i = length - 1; i >= 0; --i)
+    value = value << 8 | bytes[i];
+  return value;
+}
+
+uint64_t readBigEndian(const uint8_t *bytes, int length) {
+  uint64_t value = 0;
+  for (int i = 0; i < length; ++i)
+    value = value << 8 | bytes[i];
+  return value;
+}
+
+// One compressed table. Each symbol of a canonical Huffman code stands for
+// a pair of symbols, down to single values; the codes are stored in blocks
+// of 2^blockSize bytes, and the index table points into them every
+// 2^idxBits values.
+struct PairsData {
+  const uint8_t *indexTable = nullptr; // 6 bytes: block, offset in it
+  const uint8_t *sizeTable = nullptr;  // values per block - 1, 16 bits
+  const uint8_t *data = nullptr;
+  const uint8_t *offset = nullptr; // first symbol of each code length
+  const uint8_t *symPat = nullptr; // each symbol's pair, 12 bits each
+  int blockSize = 0;
+  int idxBits = 0; // 0 when every value is constValue
+  int minLen = 0;
+  uint8_t constValue[2] = {};
+  std::vector<uint64_t> base;  // smallest code of each length, left-aligned
+  std::vector<uint8_t> symLen; // values a symbol stands for, less one
+};
+
+// How one table (a side to move, and with pawns a file) indexes positions:
+// the order of its pieces, how they are grouped (norm) and what each
+// group's index is multiplied by.
+struct EncInfo {
+  PairsData precomp;
+  uint64_t factor[TB_PIECES] = {};
+  uint8_t pieces[TB_PIECES] = {};
+  uint8_t norm[TB_PIECES] = {};
+};
+
+// Everything about one material balance: its WDL and DTZ files, mapped
+// the first time they are probed.
+struct TBEntry {
+  std::string path[2]; // by TableType; empty if not found
+  uint64_t key = 0;    // material with the first side in the name as white
+  uint64_t key2 = 0;   // and as black
+  int num = 0;         // pieces, kings included
+  bool symmetric = false;
+  bool hasPawns = false;
+  bool kkEnc = false; // no unique pieces but the kings
+  int pawns[2] = {};  // leading colour first
+
+  std::mutex mutex;
+  std::atomic<bool> ready[2] = {{false}, {false}};
+  bool usable[2] = {};
+  void *mapping[2] = {};
+  std::size_t mappedSize[2] = {};
+
+  EncInfo wdl[8]; // pieces: by side; pawns: by file + 4 * side
+  EncInfo dtz[4]; // by file
+  const uint8_t *dtzMap = nullptr;
+  uint16_t dtzMapIdx[4][4] = {};
+  uint8_t dtzFlags[4] = {};
+
+  ~TBEntry() {
+    for (int type = WDL; type <= DTZ; ++type) {
+      if (mapping[type])
+        munmap(mapping[type], mappedSize[type]);
+    }
+  }
+};
+
+// Piece counts by colour, 4 bits per piece kind except the king; equal for
+// positions with the same material.
+uint64_t materialKey(const int (&counts)[2][7], bool swapColours) {
+  uint64_t key = 0;
+  for (int colour = 0; colour < 2; ++colour) {
+    for (int kind = 1; kind <= 5; ++kind) {
+      key |= uint64_t(counts[colour ^ swapColours][kind])
+             << (4 * (colour * 5 + kind - 1));
+    }
+  }
+  return key;
+}
+
+uint64_t materialKey(const GameState &state) {
+  int counts[2][7] = {};
+  for (int piece = W_PAWN; piece <= B_KING; ++piece) {
+    const int code = TB_PIECE[piece];
+    counts[code >> 3][code & 7] += popCount(state.pieces[piece]);
+  }
+  return materialKey(counts, false);
+}
+
+// Every table found by initTablebases, by material key (both colourings).
+struct Registry {
+  std::vector<std::unique_ptr<TBEntry>> entries;
+  std::unordered_map<uint64_t, TBEntry *> byKey;
+  int largest = 0;
+} registry;
+
+// Parses a name such as "KRPvKN" into piece counts. Returns false if it is
+// not one.
+bool parseTableName(const std::string &name, int (&counts)[2][7]) {
+  static const char KINDS[] = " PNBRQK"; // by TB piece kind
+  const std::size_t v = name.find('v');
+  if (v == std::string::npos || name.size() > TB_PIECES + 1 || v == 0 ||
+      name[0] != 'K' || v + 1 >= name.size() || name[v + 1] != 'K')
+    return false;
+  for (std::size_t i = 0; i < name.size(); ++i) {
+    if (i == v)
+      continue;
+    const char *kind = std::strchr(KINDS + 1, name[i]);
+    if (!kind || !*kind)
+      return false;
+    ++counts[i > v][kind - KINDS];
+  }
+  return counts[0][6] == 1 && counts[1][6] == 1;
+}
+
+void addTable(const std::string &path, const std::string &name,
+              TableType type) {
+  int counts[2][7] = {};
+  if (!parseTableName(name, counts))
+    return;
+  const uint64_t key = materialKey(counts, false);
+  const auto found = registry.byKey.find(key);
+  TBEntry *be = found != registry.byKey.end() ? found->second : nullptr;
+  if (!be) {
+    registry.entries.push_back(std::make_unique<TBEntry>());
+    be = registry.entries.back().get();
+    be->key = key;
+    be->key2 = materialKey(counts, true);
+    be->symmetric = be->key == be->key2;
+    int unique = 0;
+    for (int colour = 0; colour < 2; ++colour) {
+      for (int kind = 1; kind <= 6; ++kind) {
+        be->num += counts[colour][kind];
+        unique += counts[colour][kind] == 1;
+      }
+    }
+    be->hasPawns = counts[0][TB_PAWN] || counts[1][TB_PAWN];
+    be->kkEnc = !be->hasPawns && unique == 2;
+    // the leading colour has the pawns, the fewer of them if both sides do
+    const bool blackLeads =
+        counts[1][TB_PAWN] &&
+        (!counts[0][TB_PAWN] || counts[0][TB_PAWN] > counts[1][TB_PAWN]);
+    be->pawns[0] = counts[blackLeads][TB_PAWN];
+    be->pawns[1] = counts[!blackLeads][TB_PAWN];
+    registry.byKey[be->key] = registry.byKey[be->key2] = be;
+  }
+  if (!be->path[type].empty())
+    return; // found in an earlier directory
+  be->path[type] = path;
+  if (type == WDL)
+    registry.largest = std::max(registry.largest, be->num);
+}
+
+// Reading a table: header, then per side (and file) the piece order, the
+// compression parameters, the DTZ value maps, the index tables, the block
+// sizes and the 64-byte aligned compressed blocks.
+
+void calcSymLen(PairsData &d, int s, std::vector<bool> &done) {
+  const uint8_t *w = d.symPat + 3 * s;
+  const int s2 = w[2] << 4 | w[1] >> 4;
+  if (s2 == 0xFFF) {
+    d.symLen[s] = 0;
+  } else {
+    const int s1 = (w[1] & 0xF) << 8 | w[0];
+    if (!done[s1])
+      calcSymLen(d, s1, done);
+    if (!done[s2])
+      calcSymLen(d, s2, done);
+    d.symLen[s] = uint8_t(d.symLen[s1] + d.symLen[s2] + 1);
+  }
+  done[s] = true;
+}
+
+// Reads the compression parameters at `data` (advancing past them) into
+// `d`, and the sizes of its index table, size table and blocks into `size`.
+void setupPairs(PairsData &d, const uint8_t *&data, uint64_t tbSize,
+                uint64_t size[3], uint8_t &flags, TableType type) {
+  flags = data[0];
+  if (data[0] & 0x80) { // a single value
+    d.idxBits = 0;
+    d.constValue[0] = type == WDL ? data[1] : 0;
+    d.constValue[1] = 0;
+    data += 2;
+    size[0] = size[1] = size[2] = 0;
+    return;
+  }
+
+  d.blockSize = data[1];
+  d.idxBits = data[2];
+  const uint32_t realNumBlocks = uint32_t(readLittleEndian(data + 4, 4));
+  const uint32_t numBlocks = realNumBlocks + data[3];
+  const int maxLen = data[8];
+  d.minLen = data[9];
+  const int h = maxLen - d.minLen + 1;
+  const int numSyms = int(readLittleEndian(data + 10 + 2 * h, 2));
+  d.offset = data + 10;
+  d.symPat = data + 12 + 2 * h;
+  data += 12 + 2 * h + 3 * numSyms + (numSyms & 1);
+
+  const uint64_t numIndices =
+      (tbSize + (uint64_t(1) << d.idxBits) - 1) >> d.idxBits;
+  size[0] = 6 * numIndices;
+  size[1] = 2 * uint64_t(numBlocks);
+  size[2] = uint64_t(realNumBlocks) << d.blockSize;
+
+  d.symLen.assign(numSyms, 0);
+  std::vector<bool> done(numSyms);
+  for (int s = 0; s < numSyms; ++s) {
+    if (!done[s])
+      calcSymLen(d, s, done);
+  }
+
+  d.base.assign(h, 0);
+  for (int i = h - 2; i >= 0; --i) {
+    d.base[i] = (d.base[i + 1] + readLittleEndian(d.offset + 2 * i, 2) -
+                 readLittleEndian(d.offset + 2 * (i + 1), 2)) /
+                2;
+  }
+  for (int i = 0; i < h; ++i)
+    d.base[i] <<= 64 - (d.minLen + i);
+}
+
+// Number of ways to place k equal pieces on n squares.
+uint64_t subfactor(uint64_t k, uint64_t n) {
+  uint64_t f = n, l = 1;
+  for (uint64_t i = 1; i < k; ++i) {
+    f *= n - i;
+    l *= i + 1;
+  }
+  return f / l;
+}
+
+// Reads the piece order of table `t` (a file, with pawns) from `tb` and
+// works out its grouping and factors. Returns the number of positions the
+// table indexes.
+uint64_t initEncInfo(EncInfo &ei, const TBEntry &be, const uint8_t *tb,
+                     int shift, int t, Encoding enc) {
+  const bool morePawns = enc != PIECE_ENC && be.pawns[1] > 0;
+  for (int i = 0; i < be.num; ++i) {
+    ei.pieces[i] = (tb[i + 1 + morePawns] >> shift) & 0xF;
+    ei.norm[i] = 0;
+  }
+  const int order = (tb[0] >> shift) & 0xF;
+  const int order2 = morePawns ? (tb[1] >> shift) & 0xF : 0xF;
+
+  int k = ei.norm[0] = enc != PIECE_ENC ? be.pawns[0] : be.kkEnc ? 2 : 3;
+  if (morePawns) {
+    ei.norm[k] = be.pawns[1];
+    k += ei.norm[k];
+  }
+  for (int i = k; i < be.num; i += ei.norm[i]) {
+    for (int j = i; j < be.num && ei.pieces[j] == ei.pieces[i]; ++j)
+      ++ei.norm[i];
+  }
+
+  int n = 64 - k;
+  uint64_t f = 1;
+  for (int i = 0; k < be.num || i == order || i == order2; ++i) {
+    if (i == order) {
+      ei.factor[0] = f;
+      f *= enc == FILE_ENC ? indices.pawnFactor[ei.norm[0] - 1][t]
+           : be.kkEnc      ? 462
+                           : 31332;
+    } else if (i == order2) {
+      ei.factor[ei.norm[0]] = f;
+      f *= subfactor(ei.norm[ei.norm[0]], 48 - ei.norm[0]);
+    } else {
+      ei.factor[k] = f;
+      f *= subfactor(ei.norm[k], n);
+      n -= ei.norm[k];
+      k += ei.norm[k];
+    }
+  }
+  return f;
+}
+
+bool initTable(TBEntry &be, TableType type) {
+  static const uint8_t MAGIC[2][4] = {{0x71, 0xE8, 0x23, 0x5D},  // WDL
+                                      {0xD7, 0x66, 0x0C, 0xA5}}; // DTZ
+  if (be.path[type].empty())
+    return false;
+  const int fd = open(be.path[type].c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  void *mapped = MAP_FAILED;
+  // the files are a 16-byte header plus 64-byte aligned data
+  if (fstat(fd, &info) == 0 && info.st_size % 64 == 16)
+    mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED)
+    return false;
+  be.mapping[type] = mapped;
+  be.mappedSize[type] = info.st_size;
+
+  const uint8_t *data = static_cast<const uint8_t *>(mapped);
+  if (std::memcmp(data, MAGIC[type], 4) != 0)
+    return false;
+
+  const bool split = type == WDL && (data[4] & 1); // a table per side
+  data += 5;
+  const int num = be.hasPawns ? 4 : 1;
+  const Encoding enc = be.hasPawns ? FILE_ENC : PIECE_ENC;
+  EncInfo *ei = type == WDL ? be.wdl : be.dtz;
+
+  uint64_t tbSize[4][2] = {};
+  for (int t = 0; t < num; ++t) {
+    tbSize[t][0] = initEncInfo(ei[t], be, data, 0, t, enc);
+    if (split)
+      tbSize[t][1] = initEncInfo(ei[num + t], be, data, 4, t, enc);
+    data += be.num + 1 + (be.hasPawns && be.pawns[1]);
+  }
+  data += reinterpret_cast<uintptr_t>(data) & 1;
+
+  uint64_t size[4][2][3] = {};
+  for (int t = 0; t < num; ++t) {
+    uint8_t flags;
+    setupPairs(ei[t].precomp, data, tbSize[t][0], size[t][0], flags, type);
+    if (type == DTZ)
+      be.dtzFlags[t] = flags;
+    if (split)
+      setupPairs(ei[num + t].precomp, data, tbSize[t][1], size[t][1], flags,
+                 type);
+  }
+
+  if (type == DTZ) {
+    be.dtzMap = data;
+    for (int t = 0; t < num; ++t) {
+      if (!(be.dtzFlags[t] & 2))
+        continue;
+      if (!(be.dtzFlags[t] & 16)) {
+        for (int i = 0; i < 4; ++i) {
+          be.dtzMapIdx[t][i] = uint16_t(data + 1 - be.dtzMap);
+          data += 1 + data[0];
+        }
+      } else {
+        data += reinterpret_cast<uintptr_t>(data) & 1;
+        for (int i = 0; i < 4; ++i) {
+          be.dtzMapIdx[t][i] = uint16_t((data - be.dtzMap) / 2 + 1);
+          data += 2 + 2 * readLittleEndian(data, 2);
+        }
+      }
+    }
+    data += reinterpret_cast<uintptr_t>(data) & 1;
+  }
+
+  const int sides = split ? 2 : 1;
+  for (int t = 0; t < num; ++t) {
+    for (int side = 0; side < sides; ++side) {
+      ei[side * num + t].precomp.indexTable = data;
+      data += size[t][side][0];
+    }
+  }
+  for (int t = 0; t < num; ++t) {
+    for (int side = 0; side < sides; ++side) {
+      ei[side * num + t].precomp.sizeTable = data;
+      data += size[t][side][1];
+    }
+  }
+  for (int t = 0; t < num; ++t) {
+    for (int side = 0; side < sides; ++side) {
+      data = reinterpret_cast<const uint8_t *>(
+          (reinterpret_cast<uintptr_t>(data) + 0x3F) & ~uintptr_t(0x3F));
+      ei[side * num + t].precomp.data = data;
+      data += size[t][side][2];
+    }
+  }
+  return true;
+}
+
+// Maps the table on first use. Searches on several threads may want it at
+// once; one maps it and the others wait.
+bool ensureMapped(TBEntry &be, TableType type) {
+  if (be.ready[type].load(std::memory_order_acquire))
+    return be.usable[type];
+  std::lock_guard<std::mutex> lock(be.mutex);
+  if (!be.ready[type].load(std::memory_order_relaxed)) {
+    be.usable[type] = initTable(be, type);
+    be.ready[type].store(true, std::memory_order_release);
+  }
+  return be.usable[type];
+}
+
+// The symbol pattern of value number `idx`: the index table gives a block
+// and an offset near it; from there codes are decoded up to the symbol
+// covering idx, which is then expanded down its pairs.
+const uint8_t *decompressPairs(const PairsData &d, uint64_t idx) {
+  if (!d.idxBits)
+    return d.constValue;
+
+  const uint64_t mainIdx = idx >> d.idxBits;
+  int litIdx = int(idx & ((uint64_t(1) << d.idxBits) - 1)) -
+               (1 << (d.idxBits - 1));
+  uint32_t block = uint32_t(readLittleEndian(d.indexTable + 6 * mainIdx, 4));
+  litIdx += int(readLittleEndian(d.indexTable + 6 * mainIdx + 4, 2));
+
+  auto blockValues = [&d](uint32_t b) {
+    return int(readLittleEndian(d.sizeTable + 2 * b, 2)) + 1;
+  };
+  if (litIdx < 0) {
+    while (litIdx < 0)
+      litIdx += blockValues(--block);
+  } else {
+    while (litIdx >= blockValues(block))
+      litIdx -= blockValues(block++);
+  }
+
+  const uint8_t *ptr = d.data + (uint64_t(block) << d.blockSize);
+  const int m = d.minLen;
+  uint64_t code = readBigEndian(ptr, 8);
+  ptr += 8;
+  int bitCnt = 0; // bits of `code` used up
+  int sym;
+  while (true) {
+    int l = 0; // code length - minLen
+    while (code < d.base[l])
+      ++l;
+    sym = int(readLittleEndian(d.offset + 2 * l, 2) +
+              ((code - d.base[l]) >> (64 - (l + m))));
+    if (litIdx < int(d.symLen[sym]) + 1)
+      break;
+    litIdx -= int(d.symLen[sym]) + 1;
+    code <<= l + m;
+    bitCnt += l + m;
+    if (bitCnt >= 32) {
+      bitCnt -= 32;
+      code |= readBigEndian(ptr, 4) << bitCnt;
+      ptr += 4;
+    }
+  }
+
+  while (d.symLen[sym]) {
+    const uint8_t *w = d.symPat + 3 * sym;
+    const int s1 = (w[1] & 0xF) << 8 | w[0];
+    if (litIdx < int(d.symLen[s1]) + 1) {
+      sym = s1;
+    } else {
+      litIdx -= int(d.symLen[s1]) + 1;
+      sym = w[2] << 4 | w[1] >> 4;
+    }
+  }
+  return d.symPat + 3 * sym;
+}
+
+// The index of the position whose squares, in the table's piece order,
+// are `p`.
+uint64_t encode(int *p, const EncInfo &ei, const TBEntry &be, Encoding enc) {
+  const int n = be.num;
+  uint64_t idx;
+  int k;
+
+  if (p[0] & 4) { // the leading piece goes on files a-d
+    for (int i = 0; i < n; ++i)
+      p[i] ^= 7;
+  }
+
+  if (enc == PIECE_ENC) {
+    if (p[0] & 0x20) { // and ranks 1-4
+      for (int i = 0; i < n; ++i)
+        p[i] ^= 0x38;
+    }
+    // the first leading piece off the diagonal goes below it
+    for (int i = 0; i < n; ++i) {
+      if (OFF_DIAG[p[i]]) {
+        if (OFF_DIAG[p[i]] > 0 && i < (be.kkEnc ? 2 : 3)) {
+          for (int j = 0; j < n; ++j)
+            p[j] = FLIP_DIAG[p[j]];
+        }
+        break;
+      }
+    }
+
+    if (be.kkEnc) {
+      idx = indices.kkIdx[TRIANGLE[p[0]]][p[1]];
+      k = 2;
+    } else {
+      const int s1 = p[1] > p[0];
+      const int s2 = (p[2] > p[0]) + (p[2] > p[1]);
+      if (OFF_DIAG[p[0]])
+        idx = TRIANGLE[p[0]] * 63 * 62 + (p[1] - s1) * 62 + (p[2] - s2);
+      else if (OFF_DIAG[p[1]])
+        idx = 6 * 63 * 62 + DIAG[p[0]] * 28 * 62 + LOWER[p[1]] * 62 + p[2] -
+              s2;
+      else if (OFF_DIAG[p[2]])
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + DIAG[p[0]] * 7 * 28 +
+              (DIAG[p[1]] - s1) * 28 + LOWER[p[2]];
+      else
+        idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + DIAG[p[0]] * 7 * 6 +
+              (DIAG[p[1]] - s1) * 6 + (DIAG[p[2]] - s2);
+      k = 3;
+    }
+    idx *= ei.factor[0];
+  } else {
+    for (int i = 1; i < ei.norm[0]; ++i) {
+      for (int j = i + 1; j < ei.norm[0]; ++j) {
+        if (PAWN_TWIST[p[i]] < PAWN_TWIST[p[j]])
+          std::swap(p[i], p[j]);
+      }
+    }
+    k = ei.norm[0];
+    idx = indices.pawnIdx[k - 1][FLAP[p[0]]];
+    for (int i = 1; i < k; ++i)
+      idx += indices.binomial[k - i][PAWN_TWIST[p[i]]];
+    idx *= ei.factor[0];
+
+    // the other side's pawns, on the 48 squares of ranks 2-7
+    if (be.pawns[1]) {
+      const int t = k + be.pawns[1];
+      std::sort(p + k, p + t);
+      uint64_t s = 0;
+      for (int i = k; i < t; ++i) {
+        int skips = 0;
+        for (int j = 0; j < k; ++j)
+          skips += p[i] > p[j];
+        s += indices.binomial[i - k + 1][p[i] - skips - 8];
+      }
+      idx += s * ei.factor[k];
+      k = t;
+    }
+  }
+
+  // then each group of equal pieces, on the squares left
+  while (k < n) {
+    const int t = k + ei.norm[k];
+    std::sort(p + k, p + t);
+    uint64_t s = 0;
+    for (int i = k; i < t; ++i) {
+      int skips = 0;
+      for (int j = 0; j < k; ++j)
+        skips += p[i] > p[j];
+      s += indices.binomial[i - k + 1][p[i] - skips];
+    }
+    idx += s * ei.factor[k];
+    k = t;
+  }
+  return idx;
+}
+
+// Moves the leading pawn (first in FLAP order) to p[0]. Returns the file,
+// a to d, of the table it selects.
+int leadingPawn(int *p, const TBEntry &be) {
+  for (int i = 1; i < be.pawns[0]; ++i) {
+    if (FLAP[p[0]] > FLAP[p[i]])
+      std::swap(p[0], p[i]);
+  }
+  return FILE_TO_FILE[p[0] & 7];
+}
+
+// Appends to `p` the squares of the pieces of kind pc[i], seen from the
+// table's side of the board. Returns the next free index.
+int fillSquares(const GameState &state, const uint8_t *pc, bool flip,
+                int mirror, int *p, int i) {
+  const int code = pc[i] ^ (flip ? 8 : 0);
+  Bitboard b = state.pieces[ENGINE_PIECE[code]];
+  while (b)
+    p[i++] = tbSquare(popLsb(b)) ^ mirror;
+  return i;
+}
+
+// Looks `state` up in its table: a WDL value (-2..2), or for DTZ the
+// stored distance for the result `wdl`. `success` is 0 if the table is
+// missing, and -1 (DTZ only) if it is stored for the other side to move.
+// `rounded` (DTZ only) is set when the distance was stored in moves.
+int probeTable(const GameState &state, int wdl, int &success,
+               TableType type, bool *rounded = nullptr) {
+  const uint64_t key = materialKey(state);
+  if (type == WDL && key == 0)
+    return 0; // bare kings
+
+  const auto found = registry.byKey.find(key);
+  if (found == registry.byKey.end() || !ensureMapped(*found->second, type)) {
+    success = 0;
+    return 0;
+  }
+  const TBEntry &be = *found->second;
+
+  // The tables are stored with the first side of the name as white, and
+  // symmetric ones only with white to move: otherwise swap the colours.
+  bool flip, bside;
+  if (!be.symmetric) {
+    flip = key != be.key;
+    bside = state.sideToMove ^ flip;
+  } else {
+    flip = state.sideToMove != 0;
+    bside = false;
+  }
+
+  int p[TB_PIECES];
+  uint64_t idx;
+  int t = 0;
+  uint8_t flags = 0;
+  const EncInfo *ei = type == WDL ? be.wdl : be.dtz;
+
+  if (!be.hasPawns) {
+    if (type == DTZ) {
+      flags = be.dtzFlags[0];
+      if ((flags & 1) != bside && !be.symmetric) {
+        success = -1;
+        return 0;
+      }
+    }
+    ei = type == WDL ? &ei[bside] : ei;
+    for (int i = 0; i < be.num;)
+      i = fillSquares(state, ei->pieces, flip, 0, p, i);
+    idx = encode(p, *ei, be, PIECE_ENC);
+  } else {
+    int i = fillSquares(state, ei->pieces, flip, flip ? 0x38 : 0, p, 0);
+    t = leadingPawn(p, be);
+    if (type == DTZ) {
+      flags = be.dtzFlags[t];
+      if ((flags & 1) != bside && !be.symmetric) {
+        success = -1;
+        return 0;
+      }
+    }
+    ei = type == WDL ? &ei[t + 4 * bside] : &ei[t];
+    while (i < be.num)
+      i = fillSquares(state, ei->pieces, flip, flip ? 0x38 : 0, p, i);
+    idx = encode(p, *ei, be, FILE_ENC);
+  }
+
+  const uint8_t *w = decompressPairs(ei->precomp, idx);
+  if (type == WDL)
+    return int(w[0]) - 2;
+
+  // DTZ is stored in moves or plies, and for some tables through a map
+  static const int WDL_TO_MAP[5] = {1, 3, 0, 2, 0};
+  static const uint8_t PA_FLAGS[5] = {8, 0, 0, 0, 4};
+  int v = w[0] + ((w[1] & 0xF) << 8);
+  if (flags & 2) {
+    const int start = be.dtzMapIdx[t][WDL_TO_MAP[wdl + 2]];
+    v = flags & 16 ? int(readLittleEndian(be.dtzMap + 2 * (start + v), 2))
+                   : be.dtzMap[start + v];
+  }
+  const bool inMoves = !(flags & PA_FLAGS[wdl + 2]) || (wdl & 1);
+  if (rounded)
+    *rounded = inMoves;
+  return inMoves ? v * 2 : v;
+}
+
+bool isCapture(const GameState &state, const Move &move) {
+  return capturedPiece(state, move) != EMPTY;
+}
+
+bool isPawnMove(const GameState &state, const Move &move) {
+  const int piece = state.board[move.from()];
+  return piece == W_PAWN || piece == B_PAWN;
+}
+
+bool isMate(const GameState &state) {
+  if (!isInCheck(state, state.sideToMove))
+    return false;
+  MoveList moves;
+  generateAllMoves(state, moves);
+  return moves.empty();
+}
+
+// WDL with the captures searched out, which the tables may store as
+// "don't care". No en passant is possible after a capture.
+int probeAlphaBeta(GameState &state, int alpha, int beta, int &success) {
+  MoveList moves;
+  generateMoves(state, moves, GEN_CAPTURES);
+  for (const Move &move : moves) {
+    if (!isCapture(state, move))
+      continue;
+    Undo undo;
+    doMove(state, move, undo);
+    const int v = -probeAlphaBeta(state, -beta, -alpha, success);
+    undoMove(state, undo);
+    if (success == 0)
+      return 0;
+    if (v > alpha) {
+      if (v >= beta)
+        return v;
+      alpha = v;
+    }
+  }
+  const int v = probeTable(state, 0, success, WDL);
+  return alpha >= v ? alpha : v;
+}
+
+// WDL of `state`. `success` is 2 if a capture (en passant included) is
+// the best move, 1 otherwise, 0 if a table is missing.
+int probeWdl(GameState &state, int &success) {
+  success = 1;
+  MoveList moves;
+  generateMoves(state, moves, GEN_CAPTURES);
+  int bestCap = -3, bestEp = -3;
+
+  // the best capture, and separately any still better en passant one: the
+  // tables know nothing of en passant
+  for (const Move &move : moves) {
+    if (!isCapture(state, move))
+      continue;
+    Undo undo;
+    doMove(state, move, undo);
+    const int v = -probeAlphaBeta(state, -2, -bestCap, success);
+    undoMove(state, undo);
+    if (success == 0)
+      return 0;
+    if (v > bestCap) {
+      if (v == 2) {
+        success = 2;
+        return 2;
+      }
+      if (move.flag() != MOVE_EN_PASSANT)
+        bestCap = v;
+      else if (v > bestEp)
+        bestEp = v;
+    }
+  }
+
+  const int v = probeTable(state, 0, success, WDL);
+  if (success == 0)
+    return 0;
+
+  if (bestEp > bestCap) {
+    if (bestEp > v) { // an en passant capture is best
+      success = 2;
+      return bestEp;
+    }
+    bestCap = bestEp;
+  }
+  if (bestCap >= v) {
+    success = 1 + (bestCap > 0);
+    return bestCap;
+  }
+
+  // the table scores the position without en passant; if that would be
+  // stalemate, taking en passant is the only move
+  if (bestEp > -3 && v == 0) {
+    MoveList all;
+    generateAllMoves(state, all);
+    const bool onlyEp =
+        std::all_of(all.begin(), all.end(), [](const Move &move) {
+          return move.flag() == MOVE_EN_PASSANT;
+        });
+    if (onlyEp && !isInCheck(state, state.sideToMove)) {
+      success = 2;
+      return bestEp;
+    }
+  }
+  return v;
+}
+
+// DTZ of a position whose best move zeroes the count, by WDL + 2.
+const int WDL_TO_DTZ[5] = {-1, -101, 0, 101, 1};
+
+// `rounded` is set when the result comes from a distance stored in moves,
+// which reads one ply short when the true distance is even.
+int probeDtz(GameState &state, int &success, bool &rounded) {
+  rounded = false;
+  const int wdl = probeWdl(state, success);
+  if (success == 0 || wdl == 0)
+    return 0; // no DTZ for draws
+  if (success == 2) // a capture is best
+    return WDL_TO_DTZ[wdl + 2];
+
+  MoveList moves;
+  generateAllMoves(state, moves);
+  // when winning, a pawn move that keeps the win zeroes the count too
+  if (wdl > 0) {
+    for (const Move &move : moves) {
+      if (!isPawnMove(state, move) || isCapture(state, move))
+        continue;
+      Undo undo;
+      doMove(state, move, undo);
+      const int v = -probeWdl(state, success);
+      undoMove(state, undo);
+      if (success == 0)
+        return 0;
+      if (v == wdl)
+        return WDL_TO_DTZ[wdl + 2];
+    }
+  }
+
+  const int dtz = probeTable(state, wdl, success, DTZ, &rounded);
+  if (success >= 0)
+    return WDL_TO_DTZ[wdl + 2] + (wdl > 0 ? dtz : -dtz);
+
+  // stored for the other side only: one more than the best reply's, and a
+  // losing capture or pawn move is the worst a loss can get
+  int best = wdl > 0 ? INT_MAX : WDL_TO_DTZ[wdl + 2];
+  for (const Move &move : moves) {
+    if (isCapture(state, move) || isPawnMove(state, move))
+      continue;
+    Undo undo;
+    doMove(state, move, undo);
+    bool replyRounded;
+    const int v = -probeDtz(state, success, replyRounded);
+    if (v == 1 && isMate(state)) {
+      best = 1;
+      rounded = false;
+    } else if (wdl > 0 && v > 0 && v + 1 < best) {
+      best = v + 1;
+      rounded = replyRounded;
+    } else if (wdl < 0 && v - 1 < best) {
+      best = v - 1;
+      rounded = replyRounded;
+    }
+    undoMove(state, undo);
+    if (success == 0)
+      return 0;
+  }
+  return best;
+}
+
+} // namespace
+
+int initTablebases(const std::string &paths) {
+  registry.byKey.clear();
+  registry.entries.clear();
+  registry.largest = 0;
+  if (paths.empty() || paths == "<empty>")
+    return 0;
+
+  std::size_t start = 0;
+  while (start <= paths.size()) {
+    std::size_t end = paths.find(':', start);
+    if (end == std::string::npos)
+      end = paths.size();
+    const std::string dir = paths.substr(start, end - start);
+    start = end + 1;
+    if (dir.empty())
+      continue;
+
+    // every name a table could have is too many to try, so list the files
+    std::unique_ptr<DIR, int (*)(DIR *)> listing(opendir(dir.c_str()),
+                                                 closedir);
+    if (!listing)
+      continue;
+    while (const dirent *file = readdir(listing.get())) {
+      const std::string name = file->d_name;
+      if (name.size() < 6)
+        continue;
+      const std::string ext = name.substr(name.size() - 5);
+      const std::string stem = name.substr(0, name.size() - 5);
+      if (ext == ".rtbw")
+        addTable(dir + "/" + name, stem, WDL);
+      else if (ext == ".rtbz")
+        addTable(dir + "/" + name, stem, DTZ);
+    }
+  }
+
+  int found = 0;
+  for (const auto &entry : registry.entries)
+    found += !entry->path[WDL].empty();
+  return found;
+}
+
+int tablebaseLargest() { return registry.largest; }
+
+bool tablebaseCanProbe(const GameState &state, int limit) {
+  const int pieces = popCount(state.occupied);
+  return pieces <= std::min(limit, registry.largest) && !state.castling;
+}
+
+bool probeWDL(GameState &state, WDLScore &wdl) {
+  int success;
+  wdl = WDLScore(probeWdl(state, success));
+  return success != 0;
+}
+
+bool probeDTZ(GameState &state, int &dtz, bool *rounded) {
+  int success;
+  bool fromMoves;
+  dtz = probeDtz(state, success, fromMoves);
+  if (rounded)
+    *rounded = fromMoves;
+  return success != 0;
+}
+
+bool probeRoot(GameState &state, Move &bestMove, WDLScore &bestWdl) {
+  MoveList moves;
+  generateAllMoves(state, moves);
+  if (moves.empty())
+    return false;
+
+  // rank each move by the result it keeps, then by how soon it wins (or
+  // how late it loses): winning fastest to the next capture or pawn move
+  // makes progress the fifty-move rule accepts
+  long long bestRank = LLONG_MIN;
+  for (const Move &move : moves) {
+    const bool zeroing = isCapture(state, move) || isPawnMove(state, move);
+    Undo undo;
+    doMove(state, move, undo);
+    int wdl = WDL_WIN, dtz = 0, success = 1;
+    if (!isMate(state)) { // mate goes ahead of any other win
+      wdl = -probeWdl(state, success);
+      if (success && wdl != WDL_DRAW) {
+        if (zeroing) {
+          dtz = WDL_TO_DTZ[wdl + 2];
+        } else {
+          bool rounded;
+          const int theirs = probeDtz(state, success, rounded);
+          dtz = -theirs + (theirs > 0 ? -1 : 1);
+        }
+      }
+    }
+    undoMove(state, undo);
+    if (!success)
+      return false;
+
+    const long long rank = wdl * 1000000LL - dtz;
+    if (rank > bestRank) {
+      bestRank = rank;
+      bestMove = move;
+      bestWdl = WDLScore(wdl);
+    }
+  }
+  return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Moves.h"
+
+#include <string>
+
+// Syzygy endgame tablebases: the exact result of every position with few
+// enough pieces, read from .rtbw (win/draw/loss) and .rtbz (distance to
+// zeroing) files. A table is memory-mapped the first time a position needs
+// it, so only the pages the search touches are ever read from disk.
+//
+// The tables assume no castling rights and a fresh fifty-move count; the
+// engine does not track the count, so results are exact only for
+// positions reached by a capture or pawn move.
+
+// Result of a WDL probe for the side to move. A cursed win is a win the
+// fifty-move rule turns into a draw; a blessed loss is its other side.
+enum WDLScore {
+  WDL_LOSS = -2,
+  WDL_BLESSED_LOSS = -1,
+  WDL_DRAW = 0,
+  WDL_CURSED_WIN = 1,
+  WDL_WIN = 2
+};
+
+// Finds the tables in `paths`, one or more directories separated by ':'.
+// Replaces any tables found before; an empty string (or "<empty>") unloads
+// them all. Returns how many WDL tables were found.
+int initTablebases(const std::string &paths);
+
+// Pieces (kings included) of the largest WDL table found; 0 when none.
+int tablebaseLargest();
+
+// Whether the tables can answer for `state`: at most `limit` pieces (and no
+// more than the largest table) and no castling rights.
+bool tablebaseCanProbe(const GameState &state, int limit);
+
+// Win/draw/loss of `state` for the side to move. Returns false if a table
+// it needs is missing or unreadable. `state` is searched in place (through
+// its captures) and left as it was.
+bool probeWDL(GameState &state, WDLScore &wdl);
+
+// Plies to the next capture or pawn move on the way to the result: positive
+// when winning, negative when losing, 0 for a draw. Same conventions as
+// probeWDL. Some tables store the distance in moves; `rounded`, if given,
+// is set when the result came from one, and may then be one ply short.
+bool probeDTZ(GameState &state, int &dtz, bool *rounded = nullptr);
+
+// The legal move that keeps the best result for the side to move, winning
+// as quickly and losing as slowly as the tables know how, and the result
+// it keeps. Returns false if any table needed is missing.
+bool probeRoot(GameState &state, Move &move, WDLScore &wdl);
@@ -0,0 +1,61 @@
+#include "trace.h"
+
+#ifdef CHESS_TRACE
+
+#include <atomic>
+#include <cstdint>
+
+namespace {
+
+const char *const EVENT_NAMES[TRACE_EVENT_COUNT] = {
+    "attacked by pawn",
+    "attacked by knight",
+    "attacked by king",
+    "attacked by rook/queen",
+    "attacked by bishop/queen",
+    "in check (evasions generated)",
+};
+
+// Each record is packed into one word so it can be written with a single
+// relaxed atomic store: bits 0-7 event, 8-35 a, 36-63 b. Writers claim slots
+// with a fetch_add on `head` and never wait for each other; once the buffer
+// wraps, the oldest records are overwritten.
+const unsigned RING_SIZE = 1 << 16;
+std::atomic<uint64_t> ring[RING_SIZE];
+std::atomic<uint64_t> head{0};
+std::atomic<uint64_t> counts[TRACE_EVENT_COUNT];
+
+} // namespace
+
+void traceEvent(TraceEvent event, int a, int b) {
+  const uint64_t record = (uint64_t)event | (uint64_t)(a & 0xFFFFFFF) << 8 |
+                          (uint64_t)(b & 0xFFFFFFF) << 36;
+  const uint64_t slot = head.fetch_add(1, std::memory_order_relaxed);
+  ring[slot & (RING_SIZE - 1)].store(record, std::memory_order_relaxed);
+  counts[event].fetch_add(1, std::memory_order_relaxed);
+}
+
+void dumpTrace(std::ostream &out) {
+  const uint64_t end = head.exchange(0, std::memory_order_relaxed);
+  if (end == 0)
+    return;
+
+  out << "trace: " << end << " events" << std::endl;
+  for (int e = 0; e < TRACE_EVENT_COUNT; ++e) {
+    const uint64_t n = counts[e].exchange(0, std::memory_order_relaxed);
+    if (n)
+      out << "  " << EVENT_NAMES[e] << ": " << n << std::endl;
+  }
+
+  const uint64_t kept = end < RING_SIZE ? end : RING_SIZE;
+  const uint64_t shown = kept < 32 ? kept : 32;
+  out << "last " << shown << " events:" << std::endl;
+  for (uint64_t i = end - shown; i < end; ++i) {
+    const uint64_t record =
+        ring[i & (RING_SIZE - 1)].load(std::memory_order_relaxed);
+    out << "  " << EVENT_NAMES[record & 0xFF] << " "
+        << ((record >> 8) & 0xFFFFFFF) << " " << (record >> 36) << std::endl;
+  }
+}
+
+#endif
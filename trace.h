@@ -0,0 +1,29 @@
+#pragma once
+#include <ostream>
+
+// Event tracing for the move generator's hot path.
+//
+// Off by default: TRACE(...) expands to nothing and costs nothing. Build with
+// -DCHESS_TRACE (`make TRACE=1`) to record each event into a fixed-size,
+// lock-free ring buffer instead. Nothing is printed while searching;
+// dumpTrace() writes a per-event summary and the most recent events once the
+// search is over, then empties the buffer.
+
+enum TraceEvent {
+  TRACE_ATTACKED_BY_PAWN,   // a = target square, b = attacker colour
+  TRACE_ATTACKED_BY_KNIGHT, // a = target square, b = attacker colour
+  TRACE_ATTACKED_BY_KING,   // a = target square, b = attacker colour
+  TRACE_ATTACKED_BY_ROOK,   // rook or queen; a = target, b = attacker colour
+  TRACE_ATTACKED_BY_BISHOP, // bishop or queen; a = target, b = attacker colour
+  TRACE_IN_CHECK,           // generating evasions; a = king, b = checkers
+  TRACE_EVENT_COUNT
+};
+
+#ifdef CHESS_TRACE
+void traceEvent(TraceEvent event, int a, int b);
+void dumpTrace(std::ostream &out);
+#define TRACE(event, a, b) traceEvent(event, a, b)
+#else
+#define TRACE(event, a, b) ((void)0)
+inline void dumpTrace(std::ostream &) {}
+#endif
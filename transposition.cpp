@@ -0,0 +1,94 @@
+#include "transposition.h"
+
+TranspositionTable TT;
+
+namespace {
+
+// Layout of a packed data word:
+//   bits  0-15  move (Move::data, 0 for MOVE_NONE)
+//   bits 16-47  score
+//   bits 48-55  depth
+//   bits 56-57  bound
+//   bits 58-63  generation
+Move unpackMove(uint64_t data) {
+  Move move;
+  move.data = (uint16_t)data;
+  return move;
+}
+
+inline int depthOf(uint64_t data) { return (int8_t)(data >> 48); }
+inline unsigned generationOf(uint64_t data) { return data >> 58; }
+
+} // namespace
+
+void TranspositionTable::resize(std::size_t megabytes) {
+  std::size_t count = 1;
+  while (count * 2 * sizeof(Slot) <= megabytes * 1024 * 1024)
+    count *= 2;
+
+  slots.reset(new Slot[count]);
+  slotCount = count;
+  clear();
+}
+
+void TranspositionTable::clear() {
+  for (std::size_t i = 0; i < slotCount; ++i) {
+    slots[i].keyXorData.store(0, std::memory_order_relaxed);
+    slots[i].data.store(0, std::memory_order_relaxed);
+  }
+}
+
+bool TranspositionTable::probe(uint64_t key, TTData &out) const {
+  const Slot &slot = slots[key & (slotCount - 1)];
+  const uint64_t data = slot.data.load(std::memory_order_relaxed);
+  const uint64_t check = slot.keyXorData.load(std::memory_order_relaxed);
+
+  if (data == 0 || (check ^ data) != key)
+    return false;
+
+  out.move = unpackMove(data);
+  out.score = (int32_t)(uint32_t)(data >> 16);
+  out.depth = depthOf(data);
+  out.bound = (data >> 56) & 3;
+  return true;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, int bound, int score,
+                               const Move &move) {
+  Slot &slot = slots[key & (slotCount - 1)];
+  const uint64_t old = slot.data.load(std::memory_order_relaxed);
+  const bool samePosition =
+      (slot.keyXorData.load(std::memory_order_relaxed) ^ old) == key;
+
+  // Keep a deeper result for a different position from this search; anything
+  // older, shallower or for the same position gets overwritten.
+  const unsigned current = currentGeneration();
+  if (old != 0 && !samePosition && generationOf(old) == current &&
+      depthOf(old) > depth)
+    return;
+
+  uint64_t moveBits = move.data;
+  // a re-search that found no move should not wipe the one already stored
+  if (!moveBits && samePosition)
+    moveBits = old & 0xFFFF;
+
+  const uint64_t data = moveBits | (uint64_t)(uint32_t)score << 16 |
+                        (uint64_t)(uint8_t)depth << 48 |
+                        (uint64_t)(bound & 3) << 56 |
+                        (uint64_t)current << 58;
+
+  slot.keyXorData.store(key ^ data, std::memory_order_relaxed);
+  slot.data.store(data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::hashfull() const {
+  const std::size_t sample = slotCount < 1000 ? slotCount : 1000;
+  const unsigned current = currentGeneration();
+  int used = 0;
+  for (std::size_t i = 0; i < sample; ++i) {
+    const uint64_t data = slots[i].data.load(std::memory_order_relaxed);
+    if (data != 0 && generationOf(data) == current)
+      ++used;
+  }
+  return (int)(used * 1000 / sample);
+}
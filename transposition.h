@@ -0,0 +1,65 @@
+#pragma once
+#include "Moves.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// What a stored score says about the true value of the position.
+enum Bound { BOUND_NONE = 0, BOUND_UPPER = 1, BOUND_LOWER = 2, BOUND_EXACT = 3 };
+
+// One probed entry, unpacked.
+struct TTData {
+  Move move; // best (or refuting) move, MOVE_NONE when there is none
+  int score;
+  int depth;
+  int bound;
+};
+
+// Fixed-size hash table of search results addressed by GameState::key.
+//
+// Each slot is two 64-bit words: the packed data and the key XORed with that
+// data. Readers and writers never lock. If two threads write the same slot at
+// once a reader can see one thread's key word next to the other's data word,
+// but the XOR check then fails and the slot reads as a miss instead of
+// returning data for the wrong position.
+class TranspositionTable {
+public:
+  explicit TranspositionTable(std::size_t megabytes = 16) { resize(megabytes); }
+
+  // Reallocates (and clears) the table. The slot count is rounded down to a
+  // power of two that fits in `megabytes`.
+  void resize(std::size_t megabytes);
+  void clear();
+
+  // Starts a new search generation; entries from older searches are replaced
+  // first and no longer count towards occupancy. Searches may run side by
+  // side (e.g. batch analysis), so the counter is atomic.
+  void newSearch() { generation.fetch_add(1, std::memory_order_relaxed); }
+
+  bool probe(uint64_t key, TTData &out) const;
+  void store(uint64_t key, int depth, int bound, int score, const Move &move);
+
+  // Permille of slots holding an entry from the current search, estimated
+  // from the first thousand slots.
+  int hashfull() const;
+  std::size_t sizeInMegabytes() const { return (slotCount * sizeof(Slot)) >> 20; }
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> keyXorData;
+    std::atomic<uint64_t> data;
+  };
+
+  std::unique_ptr<Slot[]> slots;
+  std::size_t slotCount = 0;
+  std::atomic<unsigned> generation{0}; // only the low 6 bits are used
+
+  unsigned currentGeneration() const {
+    return generation.load(std::memory_order_relaxed) & 63;
+  }
+};
+
+// The table shared by every search.
+extern TranspositionTable TT;
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+
+// Lock-free handoff of a value from one writer thread to one reader thread,
+// such as a frame from the game loop to the renderer.
+//
+// There are three copies. The writer fills in its back copy and publishes
+// it by swapping it with the middle one; the reader swaps the middle copy
+// for its front one whenever something new has been published. Each side
+// only ever touches its own copy, so neither waits for the other and the
+// reader never sees a half-written value.
+template <typename T> class TripleBuffer {
+public:
+  // Writer: the copy to fill in, completely, before each publish(). After a
+  // publish it holds an older value, not the one just published.
+  T &back() { return slots[backIndex]; }
+  void publish() {
+    backIndex =
+        middle.exchange(backIndex | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Reader: takes the newest published value, if there is one since the
+  // last call, and returns whether it did.
+  bool update() {
+    if (!(middle.load(std::memory_order_relaxed) & FRESH))
+      return false;
+    frontIndex = middle.exchange(frontIndex, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+  const T &front() const { return slots[frontIndex]; }
+
+private:
+  static const int INDEX = 3; // low bits of middle: which slot it is
+  static const int FRESH = 4; // set while middle holds an unread value
+
+  T slots[3] = {};
+  std::atomic<int> middle{1};
+  int backIndex = 0;  // writer only
+  int frontIndex = 2; // reader only
+};
@@ -0,0 +1,284 @@
+// UCI front end, so the engine can be driven by chess GUIs and match runners
+// (cutechess-cli, fastchess, ...) instead of the SFML window. Reads commands
+// on stdin and answers on stdout:
+//
+//   uci, isready, ucinewgame, setoption name Hash|Threads value <n>,
+//   setoption name BookFile value <path>,
+//   setoption name SyzygyPath value <dir>[:<dir>...],
+//   setoption name SyzygyProbeLimit value <pieces>,
+//   setoption name EvalFile value <file.nnue>,
+//   position startpos|fen <fen> [moves <move>...],
+//   go [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>]
+//      [movetime <ms>] [depth <n>] [nodes <n>] [infinite],
+//   stop, quit
+//
+// Searches run on a thread of their own, so `stop` is read while one is
+// going. Each finished iteration is reported as an `info` line. With a book
+// open, `go` plays a book move straight away when there is one; with
+// tablebases loaded, the search looks endgames up in them, and with a
+// network loaded it evaluates with the network.
+
+#include "Moves.h"
+#include "book.h"
+#include "fen.h"
+#include "minimax.h"
+#include "nnue.h"
+#include "tablebase.h"
+#include "transposition.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// The search thread and the command loop both write to stdout.
+static std::mutex outputMutex;
+
+static void send(const std::string &line) {
+  std::lock_guard<std::mutex> lock(outputMutex);
+  std::cout << line << std::endl;
+}
+
+static std::thread searchThread;
+static std::atomic<bool> stopFlag{false};
+
+// Score as UCI wants it: centipawns, or moves to mate (negative when the
+// side to move is getting mated).
+static std::string scoreToUCI(int score) {
+  if (score >= MATE_SCORE - MAX_PLY)
+    return "mate " + std::to_string((MATE_SCORE - score + 1) / 2);
+  if (score <= -MATE_SCORE + MAX_PLY)
+    return "mate -" + std::to_string((MATE_SCORE + score) / 2);
+  return "cp " + std::to_string(score);
+}
+
+static void sendInfo(const SearchProgress &progress) {
+  std::ostringstream line;
+  line << "info depth " << progress.depth << " score "
+       << scoreToUCI(progress.score) << " nodes " << progress.nodes << " nps "
+       << progress.nodes * 1000 / std::max(progress.elapsedMs, 1LL)
+       << " time " << progress.elapsedMs << " hashfull " << TT.hashfull()
+       << " tbhits " << progress.tbHits << " pv";
+  for (int i = 0; i < progress.pvLength; ++i)
+    line << " " << moveToString(progress.pv[i]);
+  send(line.str());
+}
+
+// Stops the running search, if any, and waits for it to send its bestmove.
+static void stopSearch() {
+  if (!searchThread.joinable())
+    return;
+  stopFlag = true;
+  searchThread.join();
+}
+
+// position startpos|fen <fen> [moves <move>...]. The position is only
+// replaced if the whole command makes sense.
+static void setPosition(std::istringstream &in, GameState &game) {
+  std::string token, fen;
+  in >> token;
+  if (token == "startpos") {
+    fen = START_FEN;
+    in >> token; // "moves", if any follow
+  } else if (token == "fen") {
+    while (in >> token && token != "moves")
+      fen += token + " ";
+  } else {
+    send("info string unknown position " + token);
+    return;
+  }
+
+  GameState parsed;
+  if (!parseFEN(fen, parsed)) {
+    send("info string invalid fen " + fen);
+    return;
+  }
+  while (in >> token) {
+    Move move;
+    if (!parseMove(token, parsed, move)) {
+      send("info string illegal move " + token);
+      return;
+    }
+    parsed = makeMove(parsed, move);
+  }
+  game = parsed;
+}
+
+// An empty path (or the GUI's "<empty>") closes the book.
+static void openBook(const std::string &path) {
+  if (path.empty() || path == "<empty>")
+    BOOK.close();
+  else if (!BOOK.open(path))
+    send("info string cannot open book " + path);
+}
+
+// Loads the tablebases in `paths` (directories separated by ':'); an empty
+// path unloads them.
+static void loadTablebases(const std::string &paths) {
+  const int found = initTablebases(paths);
+  if (found > 0)
+    send("info string found " + std::to_string(found) +
+         " tablebases, up to " + std::to_string(tablebaseLargest()) +
+         " pieces");
+  else if (!paths.empty() && paths != "<empty>")
+    send("info string no tablebases in " + paths);
+}
+
+// An empty path (or "<empty>") goes back to the handcrafted evaluation.
+static void loadNetwork(const std::string &path) {
+  if (path.empty() || path == "<empty>")
+    NNUE.unload();
+  else if (NNUE.load(path))
+    send("info string loaded network " + path + " (" + NNUE.kernelName() +
+         " kernels)");
+  else
+    send("info string cannot load network " + path);
+}
+
+// go [...]: the budget for the side to move. With a clock, spend about a
+// thirtieth of the remaining time (or time / movestogo) plus most of the
+// increment, keeping a small reserve for communication lag.
+static SearchLimits parseGo(std::istringstream &in, const GameState &game,
+                            int threads, bool &infinite) {
+  SearchLimits limits;
+  limits.threads = threads;
+  // clock and increment by colour, as GameState::sideToMove (white 0)
+  long long time[2] = {0, 0}, increment[2] = {0, 0};
+  int movesToGo = 0;
+  infinite = false;
+
+  std::string token;
+  while (in >> token) {
+    if (token == "wtime")
+      in >> time[0];
+    else if (token == "btime")
+      in >> time[1];
+    else if (token == "winc")
+      in >> increment[0];
+    else if (token == "binc")
+      in >> increment[1];
+    else if (token == "movestogo")
+      in >> movesToGo;
+    else if (token == "movetime")
+      in >> limits.moveTimeMs;
+    else if (token == "depth")
+      in >> limits.depth;
+    else if (token == "nodes")
+      in >> limits.nodes;
+    else if (token == "infinite")
+      infinite = true;
+  }
+
+  const int side = game.sideToMove;
+  if (!limits.moveTimeMs && time[side] > 0) {
+    long long budget = time[side] / (movesToGo > 0 ? movesToGo : 30) +
+                       increment[side] * 3 / 4;
+    limits.moveTimeMs = std::max(1LL, std::min(budget, time[side] - 50));
+  }
+  if (infinite)
+    limits.moveTimeMs = limits.depth = limits.nodes = 0;
+  return limits;
+}
+
+static void startSearch(const GameState &game, SearchLimits limits,
+                        bool infinite) {
+  stopSearch();
+  Move bookMove;
+  if (!infinite && BOOK.probe(game, bookMove)) {
+    send("info string book move");
+    send("bestmove " + moveToString(bookMove));
+    return;
+  }
+  stopFlag = false;
+  limits.cancel = &stopFlag;
+  limits.onProgress = sendInfo;
+
+  searchThread = std::thread([game, limits, infinite] {
+    SearchStats stats;
+    evaluatedMove best = Minimax(game, game.sideToMove, limits, &stats);
+    // `go infinite` must not answer before `stop`, even if the search has
+    // nothing left to look at (e.g. it found a forced mate)
+    while (infinite && !stopFlag)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    send("bestmove " +
+         (best.move == MOVE_NONE ? std::string("0000")
+                               : moveToString(best.move)));
+  });
+}
+
+int main() {
+  GameState game;
+  parseFEN(START_FEN, game);
+  int threads = 1;
+  int probeLimit = SearchLimits().tbProbeLimit;
+
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::istringstream in(line);
+    std::string command;
+    in >> command;
+
+    if (command == "uci") {
+      send("id name chess-ai");
+      send("id author chess-ai authors");
+      send("option name Hash type spin default 16 min 1 max 4096");
+      send("option name Threads type spin default 1 min 1 max " +
+           std::to_string(MAX_THREADS));
+      send("option name BookFile type string default <empty>");
+      send("option name SyzygyPath type string default <empty>");
+      send("option name SyzygyProbeLimit type spin default " +
+           std::to_string(probeLimit) + " min 0 max 7");
+      send("option name EvalFile type string default <empty>");
+      send("uciok");
+    } else if (command == "isready") {
+      send("readyok");
+    } else if (command == "ucinewgame") {
+      stopSearch();
+      TT.clear();
+    } else if (command == "setoption") {
+      // setoption name <name> value <value>; a path may contain spaces
+      std::string token, name, value;
+      in >> token >> name >> token >> std::ws;
+      std::getline(in, value);
+      stopSearch();
+      long long count;
+      const bool numeric = name == "Hash" || name == "Threads" ||
+                           name == "SyzygyProbeLimit";
+      if (numeric && !parseCount(value, INT_MAX, count))
+        send("info string bad value for " + name);
+      else if (name == "Hash")
+        TT.resize(std::max(1LL, count));
+      else if (name == "Threads")
+        threads = int(std::clamp(count, 1LL, (long long)MAX_THREADS));
+      else if (name == "BookFile")
+        openBook(value);
+      else if (name == "SyzygyPath")
+        loadTablebases(value);
+      else if (name == "SyzygyProbeLimit")
+        probeLimit = int(std::min(count, 7LL));
+      else if (name == "EvalFile")
+        loadNetwork(value);
+      else
+        send("info string unknown option " + name);
+    } else if (command == "position") {
+      setPosition(in, game);
+    } else if (command == "go") {
+      bool infinite;
+      SearchLimits limits = parseGo(in, game, threads, infinite);
+      limits.tbProbeLimit = probeLimit;
+      startSearch(game, limits, infinite);
+    } else if (command == "stop") {
+      stopSearch();
+    } else if (command == "quit") {
+      break;
+    }
+  }
+  stopSearch();
+  return 0;
+}
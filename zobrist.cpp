@@ -0,0 +1,35 @@
+#include "zobrist.h"
+
+uint64_t zobristPieces[13][64];
+uint64_t zobristBlackToMove;
+uint64_t zobristCastling[16];
+uint64_t zobristEnPassant[8];
+
+namespace {
+
+// splitmix64; a fixed seed gives the same keys in every run, so hashes can be
+// compared between runs and processes
+uint64_t nextKey(uint64_t &s) {
+  uint64_t z = (s += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+struct KeyInit {
+  KeyInit() {
+    uint64_t seed = 20240601;
+    for (int piece = 1; piece < 13; ++piece) {
+      for (int sq = 0; sq < 64; ++sq)
+        zobristPieces[piece][sq] = nextKey(seed);
+    }
+    zobristBlackToMove = nextKey(seed);
+    // no castling rights at all (index 0) leaves the key unchanged
+    for (int rights = 1; rights < 16; ++rights)
+      zobristCastling[rights] = nextKey(seed);
+    for (int file = 0; file < 8; ++file)
+      zobristEnPassant[file] = nextKey(seed);
+  }
+} keyInit;
+
+} // namespace
@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+
+// Random keys XORed together to form GameState::key: one per (piece id,
+// square) pair, one for black to move, one per set of castling rights and
+// one per en passant file. doMove updates the key by XORing out what left a
+// square (or stopped being allowed) and XORing in what arrived.
+extern uint64_t zobristPieces[13][64];
+extern uint64_t zobristBlackToMove;
+extern uint64_t zobristCastling[16]; // indexed by GameState::castling
+extern uint64_t zobristEnPassant[8]; // indexed by the file of epSquare